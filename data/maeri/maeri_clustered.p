@@ -0,0 +1,5 @@
+{PE[i,j,k]:0<=i<3 and 0<=j<3 and 0<=k<7}
+{PE[i,j,k]->PE[i,j,k-1]; PE[i,j,k]->PE[i+1,j,k]; PE[i,j,k]->PE[i,j+1,k]; PE[i,j,k]->PE[i,j-1,k+1]}
+256 1024 64 16
+level cluster 32 1 112 {PE[i,j,k]->Cluster[i,j]} {PE[i,j,k]->PE[i,j,k-1]}
+level global 64 4 1024 {PE[i,j,k]->Array[]} {PE[i,j,k]->PE[i+1,j,k]; PE[i,j,k]->PE[i,j+1,k]; PE[i,j,k]->PE[i,j-1,k+1]}
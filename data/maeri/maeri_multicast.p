@@ -0,0 +1,4 @@
+{PE[i,j,k]:0<=i<3 and 0<=j<3 and 0<=k<7}
+{PE[i,j,k]->PE[i,j,k-1]; PE[i,j,k]->PE[i+1,j,k]; PE[i,j,k]->PE[i,j+1,k]; PE[i,j,k]->PE[i,j-1,k+1]}
+256 1024 64 16
+multicast {PE[i,j,k]->Tree[i,j]}
@@ -0,0 +1,3 @@
+{S[k,c,ox,oy,rx,ry]->PE[oy%16,ox%16]}
+{S[k,c,ox,oy,rx,ry]->T[k%16,c,floor(oy/16),floor(ox/16)]}
+{S[k,c,ox,oy,rx,ry]->Dev[floor(k/16)]}
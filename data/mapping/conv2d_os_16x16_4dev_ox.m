@@ -0,0 +1,3 @@
+{S[k,c,ox,oy,rx,ry]->PE[oy%16,(ox%56)%16]}
+{S[k,c,ox,oy,rx,ry]->T[k,c,floor(oy/16),floor((ox%56)/16)]}
+{S[k,c,ox,oy,rx,ry]->Dev[floor(ox/56)]}
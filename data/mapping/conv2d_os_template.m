@@ -0,0 +1,2 @@
+{S[k,c,ox,oy,rx,ry]->PE[oy%$X,ox%$Y]}
+{S[k,c,ox,oy,rx,ry]->T[k,c,floor(oy/$X),floor(ox/$Y)]}
@@ -0,0 +1,3 @@
+{PE[i,j]:0<=i<$X and 0<=j<$Y}
+{PE[i,j]->PE[i+1,j]; PE[i,j]->PE[i,j+1]}
+256 1024 64 16
@@ -0,0 +1,6 @@
+3 1
+{S[i,j,k,l]:0<=i<24 and 0<=j<256 and 0<=k<256 and 0<=l<256}
+{S[i,j,k,l]->A[i,k,l]} density=csf(0.5,0.1,0.02)
+{S[i,j,k,l]->B[k,j]}
+{S[i,j,k,l]->C[l,j]}
+{S[i,j,k,l]->Y[i,j]}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include "dataflow.h"
+
+namespace TENET
+{
+
+enum class CachePolicy
+{
+	LRU,
+	FIFO,
+	// software managed: filled on a miss while there is room, never evicted,
+	// written back and cleared at every slice of the access stream
+	SCRATCHPAD
+};
+
+struct CacheLevelStats
+{
+	double accesses{0};
+	double hits{0};
+	double neighbor_hits{0}; // L1 misses served by the L1 of an interconnect neighbor
+	double writebacks{0};    // dirty elements sent to the next level
+
+	double GetHitRate() const noexcept
+	{return accesses > 0 ? (hits + neighbor_hits) / accesses : 0;}
+};
+
+struct CacheReport
+{
+	CacheLevelStats l1; // all PEs together
+	CacheLevelStats l2;
+	double l2_traffic{0};  // elements moved between L2 and the PEs
+	double dram_traffic{0};
+	// GetUniqueVolume over MapSpaceTimeToNeighbor(), i.e. perfect reuse in a
+	// one hop and one time stamp window, to compare with l2_traffic
+	double analytic_unique{0};
+};
+
+/*
+	Trace-driven model of a private L1 per PE and a shared L2, sized in items
+	from the PE array. It consumes Dataflow::StreamAccesses, so the trace is
+	never materialized beyond one slice of the time map. Reads of inputs
+	allocate in L1 and L2; writes of outputs allocate dirty in L1 and are
+	written back on eviction. With forwarding an L1 read miss is served by a
+	neighbor's L1 before L2, like the analytic reuse.
+ */
+class CacheSimulator
+{
+public:
+	// l1size or l2size == 0 takes the size of the PE array
+	CacheSimulator(Dataflow& df, CachePolicy policy, bool forward = true,
+		unsigned l1size = 0, unsigned l2size = 0);
+
+	CacheReport Run(std::string tensor_name = "", unsigned slice_dims = 1);
+
+private:
+	Dataflow& _df;
+	CachePolicy _policy;
+	bool _forward;
+	unsigned _l1size;
+	unsigned _l2size;
+}; // class CacheSimulator
+
+} // namespace TENET
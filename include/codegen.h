@@ -0,0 +1,26 @@
+#pragma once
+#include "dataflow.h"
+
+namespace TENET
+{
+
+/*
+	Generate a self-contained C++ program that executes a dataflow instance by
+	instance. The loop nest is built by the ISL AST generator from the time and
+	space maps, so the instances run in time stamp order and then PE order.
+	Every instance records the tensor elements it touches on its PE. At the end
+	of each time stamp an access is unique when neither its PE nor an
+	interconnect neighbor touched the element in that or the previous time
+	stamp, the window of MapSpaceTimeToNeighbor(). The program prints the total,
+	unique and reused accesses of every tensor (to compare with GetTotalVolume
+	and GetUniqueVolume without multicast) and the reads and writes per PE.
+	Compile it natively, e.g. g++ -O2 -std=c++17, for medium-size layers.
+	Every map must be single-valued on every statement, the code is empty
+	(and the reason printed) otherwise, e.g. when a statement reads A[i] and
+	A[i+1]. Statement functions are named stmt_<statement> and their
+	arguments it_<iterator>.
+ */
+std::string GenerateSimulator(Dataflow& df);
+bool WriteSimulator(Dataflow& df, const char* filename);
+
+} // namespace TENET
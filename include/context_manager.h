@@ -0,0 +1,67 @@
+#pragma once
+#include <functional>
+#include "stt.h"
+
+namespace TENET
+{
+
+// byte limits are on the resident set size (RSS) of the process, 0 for no limit
+struct ContextLimits
+{
+	unsigned max_experiments{0};     // experiments run on one isl_ctx
+	size_t recycle_bytes{0};         // RSS growth under one isl_ctx before it is recycled
+	size_t max_experiment_bytes{0};  // RSS growth that fails an experiment
+	unsigned poll_ms{10};            // RSS sampling period during an experiment
+};
+
+struct ExperimentResult
+{
+	bool ok{false};
+	bool out_of_memory{false};
+	size_t start_bytes{0}; // RSS when the experiment started
+	size_t peak_bytes{0};  // max RSS sampled during the experiment
+
+	size_t GetPeakGrowth() const noexcept
+	{return peak_bytes > start_bytes ? peak_bytes - start_bytes : 0;}
+};
+
+/*
+	Runs a sequence of experiments in one process on a shared ISL_Context,
+	which is replaced by a fresh one after max_experiments experiments, after
+	the RSS grew by recycle_bytes under it, or after a failed experiment.
+	While an experiment runs a watchdog thread samples the RSS; past
+	max_experiment_bytes it aborts the isl_ctx, so every following ISL
+	operation fails and the experiment returns instead of exhausting memory.
+	With max_experiment_bytes set the experiment runs in a forked child with
+	a hard address space limit as well, as the abort is not checked by every
+	ISL or barvinok operation. Its output still goes to the inherited files,
+	but it cannot leave any state in the parent process.
+ */
+class ContextManager
+{
+public:
+	ContextManager(FILE* file, ContextLimits limits = {});
+
+	// experiment returns false when it fails by itself
+	ExperimentResult Run(std::function<bool(std::shared_ptr<ISL_Context>)> experiment);
+	// number of isl_ctx created so far
+	unsigned GetContextNum() const noexcept
+	{return _context_num;}
+
+	// RSS of the process, 0 when it is unknown
+	static size_t GetResidentBytes();
+
+private:
+	FILE* _file;
+	ContextLimits _limits;
+	std::shared_ptr<ISL_Context> _context;
+	unsigned _experiment_num{0}; // experiments run on _context
+	size_t _context_bytes{0};    // RSS when _context was created
+	unsigned _context_num{0};
+
+	void recycle();
+	ExperimentResult run_watched(std::function<bool(std::shared_ptr<ISL_Context>)>& experiment);
+	ExperimentResult run_forked(std::function<bool(std::shared_ptr<ISL_Context>)>& experiment);
+}; // class ContextManager
+
+} // namespace TENET
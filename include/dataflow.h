@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include "stt.h"
 #include "pe_array.h"
 #include "statement.h"
@@ -6,16 +7,154 @@
 
 namespace TENET{
 
+// cycles to move bits over a channel of bandwidth bits per cycle: the whole
+// cycles of the transfer plus the latency, 0 when nothing is moved. Every
+// delay metric of a channel uses it.
+double transfer_delay(double bits, unsigned bandwidth, unsigned avg_latency);
+
+// result of the double-buffered load/compute/store pipeline model,
+// total = compute + ingress_stall + egress_stall
+struct PipelineDelay
+{
+	double total{0};
+	double compute{0};
+	double ingress_stall{0}; // compute waits for its input tile
+	double egress_stall{0};  // compute waits for a free output buffer, and the final drain
+	unsigned tile_num{0};     // tiles simulated, fewer when tile_dims was coarsened
+};
+
+// bandwidth demand of one tile of the time map
+struct BandwidthSample
+{
+	std::vector<long> tile;
+	double cycles{0};
+	double bits{0};
+
+	double GetBandwidth() const noexcept
+	{return cycles > 0 ? bits / cycles : 0;}
+};
+
+// MACs per PE over the space domain
+struct PEWorkload
+{
+	double max{0};
+	double min{0};
+	double average{0};
+	// MAC num -> number of PEs with that many MACs, empty when the
+	// space domain is too large to enumerate
+	std::map<double, unsigned> histogram;
+};
+
+// traffic of one directed interconnect link, src sends to dst
+struct LinkLoad
+{
+	std::vector<long> src;
+	std::vector<long> dst;
+	double volume{0}; // elements over the whole run
+	double peak{0};   // max elements in one time stamp
+};
+
+// spatial reduction of an output tensor: the PEs writing the same element
+// in the same time stamp are reduced by an adder tree
+struct Reduction
+{
+	double max_fanin{0};     // max PEs reduced into one element
+	unsigned depth{0};       // levels of the adder tree
+	double latency{0};       // cycles through the adder tree
+	double add_num{0};       // additions in all adder trees
+	double egress_volume{0}; // elements leaving the array after reduction
+};
+
+// traffic handled by one level of a clustered PE array
+struct LevelTraffic
+{
+	std::string name;
+	double reuse_volume{0};     // elements forwarded over the networks of the level
+	double unique_volume{0};    // elements still moved from above the level
+	double unique_bits{0};      // bits of unique_volume
+	double cluster_bits{0};     // max bits forwarded inside one cluster
+	double cluster_footprint{0}; // max distinct elements used by one cluster
+	double delay{0};            // cycles of the busiest cluster network
+};
+
+// balance of a layer sharded over accelerator instances by the device map
+struct DeviceSplit
+{
+	unsigned device_num{0};
+	double max_mac{0};     // MACs of the busiest device
+	double average_mac{0};
+	double balance{0};     // average / max MACs, 1 when perfectly balanced
+};
+
+// data of a tensor needed by several devices
+struct DeviceTraffic
+{
+	double footprint{0};           // distinct elements over all devices
+	double max_device_volume{0};   // max elements needed by one device
+	double halo_volume{0};         // extra copies of elements shared by some devices
+	double replicated_volume{0};   // extra copies of elements every device needs
+	double inter_device_volume{0}; // elements sent between devices
+	double delay{0};               // cycles of the busiest device link
+};
+
+// one element access of the space-time access stream
+struct AccessEvent
+{
+	std::vector<long> time;
+	std::vector<long> pe;
+	unsigned tensor_id{0};             // position of the tensor in the stream
+	const std::string *tensor{nullptr};
+	AccessType type{AccessType::READ};
+	std::vector<long> element;
+};
+
+// volumes of a tensor over MapSpaceTimeToNeighbor(), see GetChunkedVolume
+struct ChunkedVolume
+{
+	double total{0};
+	double unique{0};
+	unsigned chunk_num{0};
+
+	double GetReuseVolume() const noexcept
+	{return total - unique;}
+	double GetReuseFactor() const noexcept
+	{return unique > 0 ? total / unique : 0;}
+};
+
+// statement, PE array and mapping file text of a dataflow, to rebuild it
+// in another ISL_Context
+struct DataflowText
+{
+	std::string statement;
+	std::string pe_array;
+	std::string mapping;
+};
+
 class Dataflow
 {
 public:
 	Dataflow(Statement &&st, PEArray &&pe, Mapping &&mp);
 
+	DataflowText Serialize() const;
+	// NULL when the text does not load
+	static std::unique_ptr<Dataflow> Deserialize(std::shared_ptr<ISL_Context> context,
+		const DataflowText& text);
+	// the dataflow of the given instances of the statement, instances is freed
+	Dataflow Restrict(isl_union_set *instances) const;
+
 	isl_union_map *GetSpaceMap();
 	isl_union_map *GetTimeMap();
 	isl_union_map *GetSpaceTimeMap();
 	isl_union_set *GetDomain();
 	double GetDomainSize();
+	std::pair<std::vector<std::string>, std::vector<std::string>>
+	GetTensorList() const
+	{return _st.GetTensorList();}
+	// bits moved per element, from the bits= and compression= annotations
+	double GetBitsPerItem(std::string tensor_name, AccessType type) const
+	{return _st.GetBitsPerItem(tensor_name, type);}
+	double GetDensity(std::string tensor_name) const
+	{return _st.GetDensity(tensor_name);}
 	isl_union_map *GetAccess(std::string tensor_name,
 		AccessType type);
 	isl_union_set *GetSpaceDomain();
@@ -27,24 +166,123 @@ public:
 		bool space_is_range=true, unsigned time_distance = 1, 
 		bool time_is_range = true, bool include_self = false);
 	isl_union_map * MapSpaceTimeToAccess(std::string tensor_name, AccessType type);
+	isl_union_map * MapSpaceTimeToUniqueAccess(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor);
+	// map each time stamp to its tile, i.e. its first tile_dims dimensions
+	isl_union_map *MapTimeToTile(unsigned tile_dims);
 	double GetPENum();
 	double GetTotalTime();
 	// following are functions that perform dataflow analysis
 	double GetUniqueVolume(std::string tensor_name, AccessType type,
 		isl_union_map* space_time_to_neighbor);
+	// READ unique volume counts one fetch per multicast group and cycle
+	isl_union_map *MapSpaceTimeToMulticastGroup();
+	double GetMulticastFanout(std::string tensor_name, isl_union_map* space_time_to_neighbor);
 	double GetTotalVolume(std::string tensor_name, AccessType type);
+	double GetFootprint(std::string tensor_name, AccessType type);
 	double GetReuseFactor(std::string tensor_name, AccessType type,
 		isl_union_map* space_time_to_neighbor);
 	double GetTemporalReuseVolume(std::string tensor_name, AccessType type);
 	double GetSpatialReuseVolume(std::string tensor_name, AccessType type, isl_union_map* stt_neighbor, bool is_total = true, int distance = 0);
+	// accesses reused at each time distance 1..max_distance from the same PE,
+	// and at each hop distance 0..max_hops within time_distance time stamps
+	std::vector<double> GetTemporalReuseHistogram(std::string tensor_name, AccessType type,
+		unsigned max_distance);
+	std::vector<double> GetSpatialReuseHistogram(std::string tensor_name, AccessType type,
+		unsigned max_hops, unsigned time_distance = 1);
+	// expected values under the density annotations of sparse tensors, the
+	// accesses of a tensor also scale with the density of its co-operands
+	double GetExpectedUniqueVolume(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor);
+	double GetExpectedTotalVolume(std::string tensor_name, AccessType type);
+	double GetExpectedReuseFactor(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor);
+	double GetExpectedMacNum(int mac_per_instance = 1);
 	double GetMacNum(int mac_per_instance = 1);
 	double GetMacNumPerPE(int mac_per_instance = 1);
+	// PE -> MAC num, a piecewise function over the space domain
+	isl_union_pw_qpolynomial *GetMacNumMap(int mac_per_instance = 1);
+	PEWorkload GetPEWorkload(int mac_per_instance = 1);
+	// write the busy fraction of every PE of the array as a CSV grid,
+	// one row per value of the leading PE dimensions, false when the file
+	// cannot be written or the array has more than MAX_ENUMERATED_POINTS PEs
+	bool WritePEUtilization(const char* filename);
 	double GetActivePENum();
 	double GetAverageActivePENum();
 	double GetIngressDelay(isl_union_map* space_time_to_neighbor , std::string tensor_name = "");
 	double GetEgressDelay(isl_union_map* space_time_to_neighbor, std::string tensor_name = "");
+	Reduction GetReduction(std::string tensor_name = "", unsigned adder_latency = 1);
+	// egress of the reduced outputs plus the adder tree latency
+	double GetReductionEgressDelay(std::string tensor_name = "", unsigned adder_latency = 1);
+	// MACs of the busiest PE, idle PEs do not shorten the critical path
 	double GetComputationDelay();
 	double GetDelay(isl_union_map* space_time_to_neighbor);
+	// following are per tile functions over the tiles of the time map
+	isl_union_pw_qpolynomial *GetTileUniqueVolume(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor, unsigned tile_dims);
+	// GetTileUniqueVolume weighted by the bits per item of every tensor
+	isl_union_pw_qpolynomial *GetTileUniqueBits(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor, unsigned tile_dims);
+	isl_union_pw_qpolynomial *GetTileTime(unsigned tile_dims);
+	// drops trailing tile dims while there are more than MAX_ENUMERATED_POINTS tiles
+	PipelineDelay GetPipelineDelay(isl_union_map* space_time_to_neighbor, unsigned tile_dims);
+	// type selects ingress (READ) or egress (WRITE) demand, in bits per cycle
+	std::vector<BandwidthSample> GetBandwidthProfile(isl_union_map* space_time_to_neighbor,
+		unsigned tile_dims, AccessType type, std::string tensor_name = "");
+	double GetPeakBandwidth(isl_union_map* space_time_to_neighbor,
+		unsigned tile_dims, AccessType type, std::string tensor_name = "");
+	// over coarser tiles when there are too many tiles to enumerate
+	double GetPercentileBandwidth(isl_union_map* space_time_to_neighbor,
+		unsigned tile_dims, AccessType type, double percentile, std::string tensor_name = "");
+	// visit every (PE, time stamp, element) access of the selected tensors in
+	// time stamp, PE, tensor and element order. Only the accesses of one value
+	// of the first slice_dims time dims are enumerated at a time; READ_OR_WRITE
+	// streams the reads of the inputs and the writes of the outputs. fn
+	// returns false to stop the stream.
+	void StreamAccesses(std::string tensor_name, AccessType type, unsigned slice_dims,
+		std::function<bool(const AccessEvent&)> fn);
+	// max number of distinct elements that must stay in one PE (L1) or in
+	// the whole array (L2) between their first and last use
+	double GetL1WorkingSet(std::string tensor_name, AccessType type);
+	double GetL2WorkingSet(std::string tensor_name, AccessType type);
+	// unique volume where reuse that needs data kept longer than L1 allows is lost
+	double GetCapacityAwareUniqueVolume(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor);
+	// elements brought from off chip, where the refetches that need data kept
+	// longer than L2 allows are not served by L2
+	double GetCapacityAwareFootprint(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor);
+	// [src PE->dst PE] -> [T->tensor], every element reused from another PE is
+	// attributed to the link from the lexicographically first PE that holds it
+	isl_union_map *MapLinkToTransfer(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor);
+	std::vector<LinkLoad> GetLinkLoad(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor);
+	// cycles when each time stamp lasts until its busiest link has sent its
+	// data, link_bandwidth is in bits per cycle
+	double GetContentionDelay(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor, unsigned link_bandwidth);
+	// neighbors reachable over the networks of PE array levels 0..level
+	isl_union_map *MapSpaceTimeToLevelNeighbor(unsigned level);
+	std::vector<LevelTraffic> GetLevelTraffic(std::string tensor_name, AccessType type);
+	// GetDelay where the top level ingress and egress share the array
+	// bandwidth and every level network runs in parallel with them
+	double GetHierarchicalDelay();
+	// scale-out over the devices of the device map, the space and time maps
+	// describe the array of every device. The other metrics see a single
+	// array and ignore the device map, so devices sharing PE and time stamps
+	// would be merged: take them on GetDeviceDataflows() instead.
+	bool HasDeviceMap() const noexcept
+	{return _mp.HasDeviceMap();}
+	isl_union_map *GetDeviceMap();
+	// the dataflow of every device of the device map, without the device map
+	std::vector<Dataflow> GetDeviceDataflows();
+	DeviceSplit GetDeviceSplit(int mac_per_instance = 1);
+	// an element is owned by the first device that needs it and sent from it
+	// to every other device that needs it, or from them to it for partial
+	// outputs. link_bandwidth is in bits per cycle of one device link.
+	DeviceTraffic GetDeviceTraffic(std::string tensor_name, AccessType type,
+		unsigned link_bandwidth, unsigned link_latency = 1);
 	double GetL1Read(std::string tensor_name, AccessType type);
 	double GetL1Write(std::string tensor_name, AccessType type);
 	double GetL2Read(std::string tensor_name, AccessType type,
@@ -52,6 +290,32 @@ public:
 	double GetL2Write(std::string tensor_name, AccessType type,
 		isl_union_map* space_time_to_neighbor);
 	double GetEnergy(isl_union_map* space_time_to_neighbor);
+	// off-chip traffic when the tiles of the time map run one after another
+	// and L2 keeps as much of the previous tile as fits in L2 size
+	double GetDRAMRead(std::string tensor_name, unsigned tile_dims);
+	double GetDRAMWrite(std::string tensor_name, unsigned tile_dims);
+	// dram_bandwidth is in bits per cycle like PEArray::GetBandwidth
+	double GetDRAMDelay(unsigned tile_dims, unsigned dram_bandwidth);
+
+	// run every job on num_threads workers (0 for one per core) and return
+	// their results in order. The calling thread runs its jobs on this
+	// dataflow, every other worker on a copy rebuilt from Serialize() in its
+	// own ISL_Context, so a job must only use the dataflow it is given.
+	std::vector<double> RunParallel(const std::vector<std::function<double(Dataflow&)>>& jobs,
+		unsigned num_threads = 0);
+	// GetDelay and GetEnergy over MapSpaceTimeToNeighbor(), with every
+	// tensor and access level computed as a separate job of RunParallel
+	double GetParallelDelay(unsigned num_threads = 0);
+	double GetParallelEnergy(unsigned num_threads = 0);
+	// total and unique volume with the outermost time dimension split into
+	// chunk_num ranges analyzed in parallel. A chunk misses the reuse of its
+	// first time stamp from the last stamp of the previous chunk, which is
+	// added back from slabs of these two stamps, so the result is exact.
+	ChunkedVolume GetChunkedVolume(std::string tensor_name, AccessType type,
+		unsigned chunk_num, unsigned num_threads = 0);
+
+	const PEArray& GetPEArray() const noexcept
+	{return _pe;}
 
 	Dataflow copy() const;
 
@@ -60,7 +324,31 @@ private:
 	PEArray _pe;
 	Mapping _mp;
 
-	double convert_upwqp_to_int(isl_union_pw_qpolynomial *upwqp);
+	double dram_traffic(std::string tensor_name, AccessType type, unsigned tile_dims);
+	// number of tiles of the time map
+	double tile_num(unsigned tile_dims);
+	// tensors of the given type selected by tensor_name ("" for all)
+	std::vector<std::string> select_tensors(std::string tensor_name, AccessType type) const;
+	// sum of volume(tensor) * weight(tensor) over the selected tensors
+	template<class Weight, class Fn>
+	double weighted_sum(std::string tensor_name, AccessType type, Weight weight, Fn volume);
+	template<class Fn>
+	double bits_sum(std::string tensor_name, AccessType type, Fn volume);
+	// bits of the unique volume of the selected tensors, the map is freed
+	double unique_bits(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor);
+	// GetDelay of the bits moved in and out of the array
+	double combine_delay(double ingress_bits, double egress_bits, double compute_delay);
+	// the access terms of GetEnergy of one tensor, shared with
+	// GetParallelEnergy. Every term keeps the map it is given.
+	static std::vector<std::function<double(Dataflow&, isl_union_map*)>>
+	energy_terms(std::string tensor_name, AccessType type);
+	// product of the densities of the inputs other than tensor_name
+	double co_density(std::string tensor_name) const;
+	double block_unique_volume(std::string tensor_name, AccessType type,
+		isl_union_map* space_time_to_neighbor, const std::vector<unsigned>& shape);
+	template<class Fn>
+	isl_union_pw_qpolynomial *bits_fn(std::string tensor_name, AccessType type, Fn volume);
 };
 
 } // namespace TENET
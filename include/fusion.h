@@ -0,0 +1,60 @@
+#pragma once
+#include "dataflow.h"
+
+namespace TENET
+{
+
+/*
+	Analysis of two layers executed back to back where the consumer reads the
+	tensor written by the producer. Unfused, the intermediate tensor is written
+	to DRAM by the producer and read back by the consumer. Fused, elements that
+	the producing PE also consumes stay in its L1, and the rest stay in L2 as
+	far as L2 capacity allows. Both dataflows must be created in the same
+	ISL_Context, and the two tensors must share the same index layout
+	(e.g. O[k,ox,oy] of the producer and I[c,x,y] of the consumer).
+ */
+class FusedPair
+{
+public:
+	FusedPair(
+		Dataflow &producer,
+		std::string producer_tensor,
+		Dataflow &consumer,
+		std::string consumer_tensor
+	);
+
+	// elements written by the producer and read by the consumer
+	double GetIntermediateVolume();
+	// intermediate elements consumed by the PE that produced them
+	double GetPEResidentVolume();
+	// intermediate elements that are consumed from L2
+	double GetL2ResidentVolume();
+	// DRAM reads and writes removed by fusion
+	double GetDRAMSaving();
+
+	// dram_bandwidth is in bits per cycle like PEArray::GetBandwidth
+	double GetUnfusedDelay(unsigned dram_bandwidth);
+	double GetFusedDelay(unsigned dram_bandwidth);
+	double GetUnfusedEnergy();
+	double GetFusedEnergy();
+
+private:
+	Dataflow &_producer;
+	Dataflow &_consumer;
+	std::string _producer_tensor;
+	std::string _consumer_tensor;
+
+	bool _analyzed{false};
+	double _intermediate{0};
+	double _pe_resident{0};
+	double _l2_resident{0};
+
+	void analyze();
+	// savings and DRAM traffic are in bits
+	double layer_delay(Dataflow &df, double ingress_saving, double egress_saving,
+		double dram_bits, unsigned dram_bandwidth);
+	double offchip_bits(Dataflow &df);
+	double intermediate_bits();
+}; // class FusedPair
+
+} // namespace TENET
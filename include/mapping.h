@@ -14,6 +14,9 @@ public:
 		const char* time_map_str
 	);
 	bool Load(const char* filename);
+	bool Load(std::istream& input);
+	// mapping file text that Load reads back
+	std::string Serialize() const;
 
 	isl_union_map *GetSpaceMap() const noexcept
 	{return isl_union_map_copy(_space_map.get());}
@@ -27,6 +30,16 @@ public:
         );
     }
 
+	// instance -> accelerator instance (e.g. S[...]->Dev[d]) when a layer is
+	// sharded across several arrays, NULL for a single array
+	bool HasDeviceMap() const noexcept
+	{return _device_map != nullptr;}
+	isl_union_map *GetDeviceMap() const
+	{return _device_map ? isl_union_map_copy(_device_map.get()) : NULL;}
+	void SetDeviceMap(const char* device_map_str);
+	void ClearDeviceMap() noexcept
+	{_device_map.reset();}
+
 	void PrintInfo() const;
 
 	Mapping copy() const;
@@ -34,6 +47,7 @@ private:
 	std::shared_ptr<ISL_Context> _context;
 	isl_union_map_ptr _space_map;
 	isl_union_map_ptr _time_map;
+	isl_union_map_ptr _device_map;
 
 }; // class Mapping
 
@@ -0,0 +1,108 @@
+#pragma once
+#include "dataflow.h"
+
+namespace TENET
+{
+
+enum class LayerType
+{
+	CONV2D,
+	POOL,
+	CONCAT
+}; // enum class LayerType
+
+// one layer of a network after all modules are expanded,
+// shapes follow the conv2d statements in data/statement:
+// S[k,c,ox,oy,rx,ry] -> I[c,ox*stride+rx,oy*stride+ry], W[k,c,rx,ry], O[k,ox,oy]
+struct Layer
+{
+	std::string name;
+	LayerType type{LayerType::CONV2D};
+	unsigned k{0};  // output channels
+	unsigned c{0};  // input channels
+	unsigned ox{0}; // output width
+	unsigned oy{0}; // output height
+	unsigned rx{1}; // kernel width
+	unsigned ry{1}; // kernel height
+	unsigned stride{1};
+
+	bool IsPointwise() const noexcept
+	{return rx == 1 && ry == 1;}
+	std::string GetDomainStr() const;
+};
+
+struct LayerResult
+{
+	double delay{0};
+	double energy{0};
+	double offchip{0}; // elements moved between L2 and off-chip memory
+	double mac{0};
+	bool analyzed{false};
+	// layers with the same shape_id share one analysis
+	unsigned shape_id{0};
+};
+
+class Network
+{
+public:
+	Network() = default;
+
+	// expand a network description (data/networks) into layers,
+	// params binds the free parameters of the top-level block (e.g. num_classes)
+	bool Load(
+		const char* filename,
+		unsigned in_height,
+		unsigned in_width,
+		unsigned in_channel,
+		const std::map<std::string, int>& params = {}
+	);
+
+	const std::vector<Layer>& GetLayers() const noexcept
+	{return _layers;}
+
+	// build the statement of a conv2d layer in the given context
+	Statement GetStatement(std::shared_ptr<ISL_Context> context, unsigned idx) const;
+
+	// analyze all conv2d layers on num_threads threads (0 for all cores),
+	// pointwise_mapping is used for 1x1 layers when it is not null.
+	// Each unique (canonical statement, mapping) pair is analyzed once
+	// and its result is copied to every layer of that shape. False when the
+	// pe array or a mapping does not load, or a mapping has a device map.
+	bool Analyze(
+		const char* pe_file,
+		const char* mapping_file,
+		std::vector<LayerResult>& results,
+		const char* pointwise_mapping_file = nullptr,
+		unsigned num_threads = 0
+	) const;
+
+	void PrintInfo(FILE* file) const;
+
+private:
+	struct Shape
+	{
+		unsigned c{0};
+		unsigned h{0};
+		unsigned w{0};
+	};
+	struct Block
+	{
+		std::vector<std::string> params;
+		std::vector<std::string> body;
+	};
+
+	bool expand(
+		const std::string& block_name,
+		const std::map<std::string, int>& env,
+		const Shape& input,
+		const std::string& prefix,
+		Shape& output,
+		unsigned depth
+	);
+
+	std::map<std::string, Block> _blocks;
+	std::string _top;
+	std::vector<Layer> _layers;
+}; // class Network
+
+} // namespace TENET
@@ -0,0 +1,41 @@
+#pragma once
+
+#include<algorithm>
+#include<atomic>
+#include<thread>
+#include<vector>
+
+namespace TENET
+{
+
+// number of worker threads actually used for n independent jobs,
+// requested == 0 means one thread per hardware core
+inline unsigned GetThreadNum(unsigned requested, unsigned n)
+{
+	if (requested == 0)
+		requested = std::max(1u, std::thread::hardware_concurrency());
+	return std::max(1u, std::min(requested, n));
+}
+
+// Run fn(worker_id, job_id) for every job_id in [0, n) on num_threads threads.
+// Jobs are handed out dynamically so unbalanced jobs do not idle workers.
+// isl_ctx is not thread safe, each worker must only touch ISL objects
+// created in its own ISL_Context (indexed by worker_id).
+template<class Fn>
+void ParallelFor(unsigned n, unsigned num_threads, Fn fn)
+{
+	std::atomic<unsigned> next{0};
+	auto worker = [&](unsigned worker_id)
+	{
+		for (unsigned job = next++; job < n; job = next++)
+			fn(worker_id, job);
+	};
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < num_threads; i++)
+		pool.emplace_back(worker, i);
+	worker(0);
+	for (auto& t : pool)
+		t.join();
+}
+
+} // namespace TENET
@@ -4,6 +4,18 @@
 namespace TENET
 {
 
+// one level of a clustered PE array, e.g. PEs in a cluster and clusters in
+// the array. The PEs of a cluster share its network, buffer and bandwidth.
+struct PELevel
+{
+	std::string name;
+	isl_union_map_ptr cluster;      // PE -> cluster
+	isl_union_map_ptr interconnect; // links between PEs of the same cluster
+	unsigned bandwidth{1};          // bits per cycle of one cluster network
+	unsigned avg_latency{1};
+	unsigned buffer{0};             // items per cluster, 0 for no limit
+};
+
 class PEArray
 {
 public:
@@ -19,6 +31,9 @@ public:
 	);
 
 	bool Load(const char *filename);
+	bool Load(std::istream& input);
+	// PE array file text that Load reads back
+	std::string Serialize() const;
 
 	isl_union_set *GetDomain() const
 	{return isl_union_set_copy(_domain.get());}
@@ -37,6 +52,26 @@ public:
 	unsigned GetAvgLatency() const noexcept
 	{return _avg_latency;}
 
+	// PE -> multicast group (bus or tree) that delivers one fetch to all
+	// its PEs in the same cycle, NULL when the array has no multicast
+	bool HasMulticast() const noexcept
+	{return _multicast != nullptr;}
+	isl_union_map *GetMulticast() const
+	{return _multicast ? isl_union_map_copy(_multicast.get()) : NULL;}
+	void SetMulticast(const char* multicast_str);
+
+	// levels from the innermost (e.g. cluster-local) to the outermost network
+	const std::vector<PELevel>& GetLevels() const noexcept
+	{return _levels;}
+	bool AddLevel(
+		const char* name,
+		unsigned bandwidth,
+		unsigned avg_latency,
+		unsigned buffer,
+		const char* cluster_str,
+		const char* interconnect_str
+	);
+
 	void PrintInfo() const;
 
 	PEArray copy() const;
@@ -44,6 +79,8 @@ public:
 private:
 	isl_union_set_ptr _domain;
 	isl_union_map_ptr _interconnect;
+	isl_union_map_ptr _multicast;
+	std::vector<PELevel> _levels;
 	unsigned _l1size{1};
 	unsigned _l2size{1};
 	unsigned _bandwidth{1};
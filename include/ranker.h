@@ -0,0 +1,67 @@
+#pragma once
+#include "dataflow.h"
+
+namespace TENET
+{
+
+enum class RankMetric
+{
+	DELAY,  // Dataflow::GetDelay
+	ENERGY  // Dataflow::GetEnergy
+};
+
+struct RankedMapping
+{
+	std::string name;      // mapping file
+	double estimate{0};    // approximate metric of the first phase
+	double error{0};       // standard error of the estimate from sampling
+	bool exact_valid{false};
+	double exact{0};       // exact metric, only for the top-k
+};
+
+struct Ranking
+{
+	// the top-k by exact metric, then the other mappings by estimate
+	std::vector<RankedMapping> mappings;
+	unsigned top_k{0};
+	// probability that no mapping outside the top-k has a better metric than
+	// the worst estimate in it, from the sampling errors of the estimates
+	double confidence{1};
+	// Kendall tau between the estimated and exact order of the top-k,
+	// 1 when the first phase already ordered them correctly
+	double agreement{1};
+};
+
+/*
+	Two phase ranking of the mappings of one statement on one PE array. The
+	first phase estimates the metric of every mapping from a few uniformly
+	sampled time stamps: the unique volumes and the MACs of every PE at a
+	stamp are counted exactly on the dataflow restricted to it and the stamp
+	before it, and scaled by the number of time stamps. Terms that do not depend on the mapping are
+	counted once. The second phase computes the exact metric with the
+	Dataflow functions for the best top_k estimates only.
+ */
+class Ranker
+{
+public:
+	Ranker(unsigned samples = 32, unsigned seed = 1);
+
+	bool Load(const char* pe_file, const char* statement_file);
+	// false when the mapping does not load or has a device map
+	bool AddMapping(const char* mapping_file);
+
+	Ranking Rank(RankMetric metric, unsigned top_k, unsigned num_threads = 0) const;
+
+private:
+	unsigned _samples;
+	unsigned _seed;
+	std::string _pe;
+	std::string _statement;
+	std::vector<std::pair<std::string, std::string>> _mappings; // name, text
+
+	// estimate and its standard error
+	std::pair<double, double> estimate(Dataflow& df, RankMetric metric,
+		double fixed_energy, unsigned seed) const;
+}; // class Ranker
+
+} // namespace TENET
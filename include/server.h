@@ -0,0 +1,74 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "dataflow.h"
+
+namespace TENET
+{
+
+/*
+	Long-lived analysis server. Requests and responses are JSON lines:
+	{"id": 1, "statement": "data/statement/conv1_1_vgg16.s",
+	 "mapping": "data/mapping/conv2d_os_16x16.m", "pe": "data/pe_array/pe_16_16.p",
+	 "metrics": ["delay", "energy"]}
+	-> {"id": 1, "delay": 1234, "energy": 5678}
+	statement, mapping and pe are file paths, or the file content itself when
+	they contain a newline or start with '{', mappings with a device map are
+	rejected. Inputs that fail to load get an error response. Every worker
+	thread owns a warm ISL_Context with the dataflows it has built and their
+	memoized metrics.
+	Requests with the same inputs go to the same worker, responses are written
+	as soon as they are ready and may come out of order.
+ */
+class AnalysisServer
+{
+public:
+	// num_workers == 0 means one worker per hardware core
+	AnalysisServer(unsigned num_workers = 0, unsigned max_cached_dataflows = 64);
+	~AnalysisServer();
+	AnalysisServer(const AnalysisServer&) = delete;
+	AnalysisServer& operator=(const AnalysisServer&) = delete;
+
+	// serve the requests from in until it is closed
+	void Serve(FILE* in, FILE* out);
+	// serve every connection to a Unix socket on its own thread, only
+	// returns (false) when the socket cannot be opened
+	bool ServeSocket(const char* socket_path);
+
+	static const std::vector<std::string>& GetMetricNames();
+
+private:
+	struct Job
+	{
+		std::string request_id;
+		std::string key; // statement, mapping and pe text
+		std::string statement;
+		std::string mapping;
+		std::string pe;
+		std::vector<std::string> metrics;
+		std::function<void(const std::string&)> reply;
+	};
+	struct Worker
+	{
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable ready;
+		std::deque<Job> jobs;
+		bool stop{false};
+		std::shared_ptr<ISL_Context> context;
+		std::map<std::string, std::unique_ptr<Dataflow>> dataflows;
+		std::map<std::string, double> results;
+	};
+
+	std::vector<std::unique_ptr<Worker>> _workers;
+	unsigned _max_cached_dataflows;
+
+	void run(Worker& worker);
+	std::string handle(Worker& worker, const Job& job);
+	double evaluate(Dataflow& df, const std::string& metric, bool& valid);
+}; // class AnalysisServer
+
+} // namespace TENET
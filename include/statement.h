@@ -11,6 +11,31 @@ enum class AccessType
 	READ_OR_WRITE
 }; // enum class Access Type
 
+// density model of a sparse tensor, written in statement files as
+// uniform(d): every element is nonzero with probability d
+// block(d,b0,b1,...): blocks of shape b0 x b1 x ... are nonzero with probability d
+// csf(d0,d1,...): compressed fibers, level i keeps a fraction di of its fibers
+// densities are in (0,1] and block sizes at least 1
+struct Sparsity
+{
+	enum class Model
+	{
+		DENSE,
+		UNIFORM,
+		BLOCK,
+		CSF
+	} model{Model::DENSE};
+	std::vector<double> params;
+
+	bool Parse(const std::string& str);
+	// the annotation read by Parse, empty when dense
+	std::string ToString() const;
+	// expected fraction of nonzero elements
+	double GetDensity() const;
+	// block sizes of a block() model, empty for the other models
+	std::vector<unsigned> GetBlockShape() const;
+};
+
 class Access
 {
 public:
@@ -25,6 +50,18 @@ public:
 	);
 	isl_union_map *GetAccess() const noexcept
 	{return isl_union_map_copy(_access.get());}
+	// element width, and the fraction of it that is stored or moved
+	// after compression (or the density of a sparse tensor)
+	unsigned GetBits() const noexcept
+	{return _bits;}
+	double GetCompression() const noexcept
+	{return _compression;}
+	void SetBits(unsigned bits, double compression = 1.0) noexcept
+	{_bits = bits; _compression = compression;}
+	const Sparsity& GetSparsity() const noexcept
+	{return _sparsity;}
+	void SetSparsity(const Sparsity& sparsity)
+	{_sparsity = sparsity;}
 	void PrintInfo() const;
 
 	Access copy() const;
@@ -32,6 +69,9 @@ private:
 	std::string _tensor_name;
 	isl_union_map_ptr _access;
 	bool _is_write{false};
+	unsigned _bits{BIT_PER_ITEM};
+	double _compression{1.0};
+	Sparsity _sparsity;
 
 	std::shared_ptr<ISL_Context> _context;
 
@@ -49,9 +89,14 @@ public:
 
 	void AddAccess(Access &&ac);
 	bool Load(const char* filename);
+	bool Load(std::istream& input);
+	// statement file text that Load reads back
+	std::string Serialize() const;
 
 	isl_union_set *GetDomain() const
 	{return isl_union_set_copy(_domain.get());}
+	// keep only the given instances of the domain, instances is freed
+	void IntersectDomain(isl_union_set *instances);
 
 	isl_union_map *GetAccess(std::string tensor_name, AccessType type) const;
 
@@ -60,6 +105,20 @@ public:
 	std::pair<std::vector<std::string>, std::vector<std::string>>
 	GetTensorList() const;
 
+	// bits moved per element of the tensor (bits * compression of its first
+	// access of that type), BIT_PER_ITEM when the tensor is not accessed
+	double GetBitsPerItem(std::string tensor_name, AccessType type) const;
+	// expected fraction of nonzero elements of the tensor, 1 when dense
+	double GetDensity(std::string tensor_name) const;
+	// block shape of a block sparse tensor, empty otherwise
+	std::vector<unsigned> GetBlockShape(std::string tensor_name) const;
+
+	// a text key that only depends on the shape of the statement and the
+	// bits, compression and density of its accesses: statement, iterator and
+	// tensor names are replaced positionally and constraints are normalized,
+	// so statements with equal keys give equal metrics
+	std::string GetCanonicalKey() const;
+
 	Statement copy() const;
 private:
 	isl_union_set_ptr _domain;
@@ -2,11 +2,13 @@
 
 
 #include<algorithm>
+#include<cmath>
 #include<fstream>
 #include<map>
 #include<memory>
 #include<stdio.h>
 #include<stdlib.h>
+#include<sstream>
 #include<string>
 #include<cstring>
 #include<vector>
@@ -21,11 +23,17 @@ namespace TENET
 
 const unsigned MAX_STR_LEN{1000};
 const unsigned BIT_PER_ITEM{16};
+// point-wise analyses enumerate at most this many points, bounds are used beyond
+const double MAX_ENUMERATED_POINTS{1 << 16};
 // #define DEBUG
 // these multipliers are energy cost per access
 // which comes from maestro
 const double l2_multiplier{18.61};
 const double l1_multiplier{1.68};
+// off-chip access, relative to one MAC as in the Eyeriss energy hierarchy
+const double dram_multiplier{200.0};
+// delivery of a multicast element from its bus or tree to one PE
+const double fanout_multiplier{2.0};
 
 class ISL_Context
 {
@@ -62,5 +70,28 @@ private:
     isl_printer *_p;
 }; // class ISL_Context
 
+// convert a union piecewise quasi-polynomial with an empty domain to its value,
+// upwqp is freed
+double convert_upwqp_to_int(isl_union_pw_qpolynomial *upwqp);
+// same for the max/min bound of a union piecewise quasi-polynomial,
+// upwqpf is freed
+double convert_upwqpf_to_int(isl_union_pw_qpolynomial_fold *upwqpf);
+// text of a union set or map that isl_union_*_read_from_str reads back,
+// the object is not freed
+std::string ToString(isl_union_set *uset);
+std::string ToString(isl_union_map *umap);
+
+struct PointValue
+{
+    std::vector<long> coords;
+    std::vector<double> values;
+};
+
+// evaluate every function on every point of domain, the points are returned
+// in lexicographic order. domain and fns are freed, only use it on small domains
+std::vector<PointValue> EvaluateOnPoints(
+    isl_union_set *domain,
+    std::vector<isl_union_pw_qpolynomial*> fns);
+
 }
 // namespace TENET
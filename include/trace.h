@@ -0,0 +1,63 @@
+#pragma once
+#include "dataflow.h"
+
+namespace TENET
+{
+
+struct TraceTensor
+{
+	std::string name;
+	AccessType type{AccessType::READ};
+	unsigned dims{0};
+};
+
+struct TraceHeader
+{
+	unsigned pe_dims{0};
+	unsigned time_dims{0};
+	std::vector<TraceTensor> tensors; // indexed by AccessEvent::tensor_id
+};
+
+/*
+	Write the access stream of a dataflow (Dataflow::StreamAccesses over all
+	inputs and outputs) as a binary trace. After the header every record is a
+	varint tag followed by zigzag varint deltas:
+	  0        new time stamp, deltas to the previous time stamp
+	  1        new active PE in the time stamp, deltas to the previous PE
+	  2 + id   access of tensor id by that PE, deltas to the previous element
+	           of the same tensor
+	Memory is bounded by one slice of the first slice_dims time dims.
+	Returns false if the file cannot be opened or any write fails.
+ */
+bool WriteTrace(Dataflow& df, const char* filename, unsigned slice_dims = 1);
+
+class TraceReader
+{
+public:
+	TraceReader() = default;
+	~TraceReader();
+	TraceReader(const TraceReader&) = delete;
+	TraceReader& operator=(const TraceReader&) = delete;
+
+	bool Open(const char* filename);
+	const TraceHeader& GetHeader() const noexcept
+	{return _header;}
+	// the next access, false at the end of the trace or on a corrupt record
+	bool Next(AccessEvent& event);
+	// number of time stamps started so far
+	unsigned long GetTimeStampNum() const noexcept
+	{return _time_stamp_num;}
+
+private:
+	FILE* _file{nullptr};
+	TraceHeader _header;
+	std::vector<long> _time;
+	std::vector<long> _pe;
+	std::vector<std::vector<long>> _elements;
+	unsigned long _time_stamp_num{0};
+
+	bool read_varint(unsigned long& value);
+	bool read_deltas(std::vector<long>& values);
+}; // class TraceReader
+
+} // namespace TENET
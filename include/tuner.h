@@ -0,0 +1,103 @@
+#pragma once
+#include <functional>
+#include "network.h"
+
+namespace TENET
+{
+
+// area relative to one PE without its L1
+const double sram_area_per_item{0.002};
+const double bandwidth_area_per_bit{0.05};
+
+struct HardwareBudget
+{
+	unsigned max_pe{256};
+	unsigned max_sram{1 << 20}; // items of all L1 and L2 buffers
+};
+
+// candidate values of every searched PEArray field
+struct TunerSpace
+{
+	std::vector<unsigned> dims; // X and Y, powers of two up to max_pe when empty
+	// the value of the PE array template is used when a list is empty
+	std::vector<unsigned> l1_sizes;
+	std::vector<unsigned> l2_sizes;
+	std::vector<unsigned> bandwidths;
+	unsigned dram_bandwidth{64}; // bits per cycle
+};
+
+struct HardwareConfig
+{
+	unsigned x{0};
+	unsigned y{0};
+	unsigned l1size{0};
+	unsigned l2size{0};
+	unsigned bandwidth{0};
+	double delay{0};
+	double energy{0};
+	double area{0};
+
+	// no worse in delay, energy and area, and better in one of them
+	bool Dominates(const HardwareConfig& other) const noexcept;
+};
+
+/*
+	Search PE array shapes and buffer sizes for a workload. The PE array and
+	mapping are templates where $X and $Y stand for the array dimensions, e.g.
+	{S[k,c,ox,oy,rx,ry]->PE[oy%$X,ox%$Y]}. The ISL analysis runs once per
+	(X, Y); the effect of L1, L2 and bandwidth is derived from its result:
+	reuse across time stamps is lost in the fraction of the L1 working set that
+	does not fit, and DRAM traffic grows in the fraction of the L2 working set
+	that does not fit.
+ */
+class Tuner
+{
+public:
+	Tuner() = default;
+
+	// the L1, L2 and bandwidth of the PE array template are the values Search
+	// uses for sizes it does not search. False when a template does not load
+	// or the mapping has a device map.
+	bool Load(const char* pe_template, const char* mapping_template);
+	bool AddStatement(const char* statement_file);
+	// network must outlive the tuner, its conv2d layers are added
+	void AddNetwork(const Network& network);
+
+	std::vector<HardwareConfig> Search(
+		const HardwareBudget& budget,
+		const TunerSpace& space,
+		unsigned num_threads = 0
+	) const;
+	// configurations not dominated by any other, sorted by delay
+	static std::vector<HardwareConfig> GetFrontier(const std::vector<HardwareConfig>& configs);
+
+private:
+	// metrics of one workload on an X x Y array that do not depend on sizes
+	struct Cost
+	{
+		double compute_delay{0};
+		double ingress_bits{0};
+		double spatial_ingress_bits{0}; // without reuse across time stamps
+		double egress_bits{0};
+		double footprint_bits{0};
+		double l1_working_set{0};
+		double l2_working_set{0};
+		double energy{0};
+	};
+
+	std::string _pe_template;
+	std::string _mapping_template;
+	unsigned _l1size{1};
+	unsigned _l2size{1};
+	unsigned _bandwidth{1};
+	std::vector<std::function<Statement(std::shared_ptr<ISL_Context>)>> _workloads;
+
+	// the PE array and mapping of an X x Y array
+	bool load(std::shared_ptr<ISL_Context> context, unsigned x, unsigned y,
+		PEArray& pe, Mapping& mp) const;
+	// false when the templates do not load for the shape
+	bool analyze(std::shared_ptr<ISL_Context> context, unsigned x, unsigned y,
+		std::vector<Cost>& costs, unsigned& avg_latency) const;
+}; // class Tuner
+
+} // namespace TENET
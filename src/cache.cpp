@@ -0,0 +1,204 @@
+#include "cache.h"
+#include <list>
+#include <unordered_map>
+
+using namespace std;
+using namespace TENET;
+
+namespace
+{
+
+// tensor id followed by the element coordinates
+typedef vector<long> Key;
+
+struct KeyHash
+{
+	size_t operator()(const Key& key) const noexcept
+	{
+		size_t h = 14695981039346656037ull;
+		for (long v : key)
+			h = (h ^ (size_t)v) * 1099511628211ull;
+		return h;
+	}
+};
+
+class Buffer
+{
+public:
+	Buffer(CachePolicy policy, unsigned size): _policy(policy), _size(size) {}
+
+	bool Contains(const Key& key) const
+	{return _index.count(key) > 0;}
+
+	// true on a hit, LRU moves the element to the back
+	bool Lookup(const Key& key, bool write)
+	{
+		auto it = _index.find(key);
+		if (it == _index.end())
+			return false;
+		it->second->second |= write;
+		if (_policy == CachePolicy::LRU)
+			_order.splice(_order.end(), _order, it->second);
+		return true;
+	}
+
+	// insert a missing element, evicted dirty elements are appended to dirty
+	void Insert(const Key& key, bool write, vector<Key>& dirty)
+	{
+		if (_size == 0)
+		{
+			if (write)
+				dirty.push_back(key);
+			return;
+		}
+		if (_index.size() >= _size)
+		{
+			if (_policy == CachePolicy::SCRATCHPAD)
+			{
+				// no room left, the element bypasses the scratchpad
+				if (write)
+					dirty.push_back(key);
+				return;
+			}
+			if (_order.front().second)
+				dirty.push_back(_order.front().first);
+			_index.erase(_order.front().first);
+			_order.pop_front();
+		}
+		_order.emplace_back(key, write);
+		_index[key] = prev(_order.end());
+	}
+
+	// drop every element, the dirty ones are appended to dirty
+	void Clear(vector<Key>& dirty)
+	{
+		for (auto& [key, is_dirty] : _order)
+			if (is_dirty)
+				dirty.push_back(key);
+		_order.clear();
+		_index.clear();
+	}
+
+private:
+	CachePolicy _policy;
+	unsigned _size;
+	list<pair<Key, bool>> _order; // element, dirty
+	unordered_map<Key, list<pair<Key, bool>>::iterator, KeyHash> _index;
+};
+
+} // namespace
+
+CacheSimulator::CacheSimulator(
+	Dataflow& df,
+	CachePolicy policy,
+	bool forward,
+	unsigned l1size,
+	unsigned l2size):
+	_df(df),
+	_policy(policy),
+	_forward(forward),
+	_l1size(l1size ? l1size : df.GetPEArray().GetL1Size()),
+	_l2size(l2size ? l2size : df.GetPEArray().GetL2Size())
+{}
+
+CacheReport
+CacheSimulator::Run(string tensor_name, unsigned slice_dims)
+{
+	CacheReport report;
+	const PEArray& pe = _df.GetPEArray();
+	// PE coordinates -> L1 and interconnect neighbors
+	map<vector<long>, unsigned> pe_index;
+	for (auto& point : EvaluateOnPoints(pe.GetDomain(), {}))
+		pe_index.emplace(point.coords, pe_index.size());
+	vector<Buffer> l1(pe_index.size(), Buffer(_policy, _l1size));
+	Buffer l2(_policy, _l2size);
+	vector<vector<unsigned>> neighbors(pe_index.size());
+	isl_union_map *interconnect = isl_union_map_intersect_range(
+		isl_union_map_intersect_domain(pe.GetInterconnect(), pe.GetDomain()), pe.GetDomain());
+	for (auto& link : EvaluateOnPoints(isl_union_map_wrap(interconnect), {}))
+	{
+		unsigned dims = link.coords.size() / 2;
+		vector<long> src(link.coords.begin(), link.coords.begin() + dims);
+		vector<long> dst(link.coords.begin() + dims, link.coords.end());
+		neighbors[pe_index[src]].push_back(pe_index[dst]);
+	}
+
+	// dirty elements leaving L1 go to L2, those leaving L2 go to DRAM
+	vector<Key> l1_dirty, l2_dirty;
+	auto drain = [&]()
+	{
+		for (auto& key : l1_dirty)
+		{
+			report.l1.writebacks++;
+			if (!l2.Lookup(key, true))
+				l2.Insert(key, true, l2_dirty);
+		}
+		l1_dirty.clear();
+		report.l2.writebacks += l2_dirty.size();
+		report.dram_traffic += l2_dirty.size();
+		l2_dirty.clear();
+	};
+
+	vector<long> slice;
+	Key key;
+	_df.StreamAccesses(tensor_name, AccessType::READ_OR_WRITE, slice_dims, [&](const AccessEvent& event)
+	{
+		if (_policy == CachePolicy::SCRATCHPAD &&
+			!equal(slice.begin(), slice.end(), event.time.begin()))
+		{
+			for (auto& buffer : l1)
+				buffer.Clear(l1_dirty);
+			drain();
+			l2.Clear(l2_dirty);
+			drain();
+		}
+		slice.assign(event.time.begin(), event.time.begin() + min<size_t>(slice_dims, event.time.size()));
+
+		bool write = event.type == AccessType::WRITE;
+		key.assign(1, event.tensor_id);
+		key.insert(key.end(), event.element.begin(), event.element.end());
+		auto pe_it = pe_index.find(event.pe);
+		if (pe_it == pe_index.end()) // mapped outside the PE array
+			return true;
+		unsigned p = pe_it->second;
+		report.l1.accesses++;
+		if (l1[p].Lookup(key, write))
+		{
+			report.l1.hits++;
+			return true;
+		}
+		bool forwarded = _forward && !write && any_of(neighbors[p].begin(), neighbors[p].end(),
+			[&](unsigned n) { return l1[n].Contains(key); });
+		if (forwarded)
+			report.l1.neighbor_hits++;
+		else if (!write || l2.Contains(key))
+		{
+			// reads, and partial outputs written back before, come from L2
+			report.l2.accesses++;
+			if (l2.Lookup(key, false))
+				report.l2.hits++;
+			else
+			{
+				report.dram_traffic++;
+				l2.Insert(key, false, l2_dirty);
+			}
+		}
+		l1[p].Insert(key, write, l1_dirty);
+		drain();
+		return true;
+	});
+	for (auto& buffer : l1)
+		buffer.Clear(l1_dirty);
+	drain();
+	l2.Clear(l2_dirty);
+	drain();
+
+	report.l2_traffic = report.l2.accesses + report.l1.writebacks;
+	auto [input, output] = _df.GetTensorList();
+	for (auto [tensors, type] : {make_pair(input, AccessType::READ), make_pair(output, AccessType::WRITE)})
+		for (auto& tensor : tensors)
+			if (tensor_name == "" || tensor_name == tensor)
+				report.analytic_unique += _df.GetUniqueVolume(tensor, type,
+					_df.MapSpaceTimeToNeighbor());
+	return report;
+}
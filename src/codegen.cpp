@@ -0,0 +1,378 @@
+#include "codegen.h"
+#include <isl/aff.h>
+#include <isl/ast_build.h>
+
+using namespace std;
+using namespace TENET;
+
+namespace
+{
+
+const char* simulator_types = R"(#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <initializer_list>
+#include <unordered_set>
+#include <vector>
+
+#define floord(n, d) (((n) < 0) ? -((-(n) + (d) - 1) / (d)) : (n) / (d))
+#define min(x, y) ((x) < (y) ? (x) : (y))
+#define max(x, y) ((x) > (y) ? (x) : (y))
+
+// PE index followed by the element coordinates
+typedef std::array<long, KEY_SIZE> Key;
+struct KeyHash
+{
+	size_t operator()(const Key& key) const noexcept
+	{
+		size_t h = 14695981039346656037ull;
+		for (long v : key)
+			h = (h ^ (size_t)v) * 1099511628211ull;
+		return h;
+	}
+};
+
+struct Counter
+{
+	const char* name;
+	bool write;
+	long total;
+	long unique;
+	std::unordered_set<Key, KeyHash> prev;
+	std::unordered_set<Key, KeyHash> cur;
+};
+)";
+
+const char* simulator_functions = R"(
+static long instances = 0;
+static long stamp[TIME_DIMS];
+static bool started = false;
+static long pe_reads[PE_NUM];
+static long pe_writes[PE_NUM];
+
+static long pe_index(std::initializer_list<long> coords)
+{
+	long index = 0;
+	int d = 0;
+	for (long c : coords)
+	{
+		index = index * pe_extent[d] + c - pe_lo[d];
+		d++;
+	}
+	return index;
+}
+
+// an access is reused from the same PE in the previous time stamp, or from
+// a neighbor in the same or the previous time stamp
+static void flush()
+{
+	for (auto& c : counters)
+	{
+		for (auto& key : c.cur)
+		{
+			c.total++;
+			bool reused = c.prev.count(key) > 0;
+			Key other = key;
+			for (int n = neighbor_begin[key[0]]; !reused && n < neighbor_begin[key[0] + 1]; n++)
+			{
+				other[0] = neighbor[n];
+				reused = c.prev.count(other) > 0 || (other[0] != key[0] && c.cur.count(other) > 0);
+			}
+			if (!reused)
+				c.unique++;
+		}
+		c.prev.swap(c.cur);
+		c.cur.clear();
+	}
+}
+
+static void enter(std::initializer_list<long> time)
+{
+	instances++;
+	if (started && std::equal(time.begin(), time.end(), stamp))
+		return;
+	if (started)
+		flush();
+	std::copy(time.begin(), time.end(), stamp);
+	started = true;
+}
+
+static void access(int tensor, long pe, std::initializer_list<long> index)
+{
+	Key key{};
+	key[0] = pe;
+	std::copy(index.begin(), index.end(), key.begin() + 1);
+	counters[tensor].cur.insert(key);
+	(counters[tensor].write ? pe_writes : pe_reads)[pe]++;
+}
+)";
+
+const char* simulator_report = R"(
+	flush();
+	printf("Instances: %ld\n", instances);
+	for (auto& c : counters)
+		printf("%s %s: total %ld unique %ld reused %ld\n", c.name, c.write ? "WRITE" : "READ",
+			c.total, c.unique, c.total - c.unique);
+	long max_reads = 0, max_writes = 0, min_reads = -1, min_writes = -1;
+	for (long pe = 0; pe < PE_NUM; pe++)
+	{
+		if (!pe_valid[pe])
+			continue;
+		max_reads = max(max_reads, pe_reads[pe]);
+		max_writes = max(max_writes, pe_writes[pe]);
+		min_reads = min_reads < 0 ? pe_reads[pe] : min(min_reads, pe_reads[pe]);
+		min_writes = min_writes < 0 ? pe_writes[pe] : min(min_writes, pe_writes[pe]);
+	}
+	printf("PE reads: max %ld min %ld\nPE writes: max %ld min %ld\n",
+		max_reads, min_reads, max_writes, min_writes);
+	return 0;
+}
+)";
+
+isl_stat collect_set(isl_set *set, void *user)
+{
+	static_cast<vector<isl_set*>*>(user)->push_back(set);
+	return isl_stat_ok;
+}
+
+string pw_aff_to_c(isl_pw_aff *pa)
+{
+	isl_printer *p = isl_printer_to_str(isl_pw_aff_get_ctx(pa));
+	p = isl_printer_set_output_format(p, ISL_FORMAT_C);
+	p = isl_printer_print_pw_aff(p, pa);
+	char *s = isl_printer_get_str(p);
+	string ret = s == NULL ? "0" : s;
+	free(s);
+	isl_printer_free(p);
+	isl_pw_aff_free(pa);
+	return ret;
+}
+
+// C expressions of the output dims of umap on the instances of the statement
+// set, in terms of the dims named in names, empty when umap has none of them.
+// False when umap is not single-valued on them. umap is freed
+bool c_exprs(isl_union_map *umap, isl_set *set, const vector<string>& names, vector<string>& exprs)
+{
+	exprs.clear();
+	umap = isl_union_map_intersect_domain(umap, isl_union_set_from_set(isl_set_copy(set)));
+	if (isl_union_map_is_empty(umap))
+	{
+		isl_union_map_free(umap);
+		return true;
+	}
+	isl_map *map = isl_map_from_union_map(umap);
+	if (map == NULL || isl_map_is_single_valued(map) != isl_bool_true)
+	{
+		isl_map_free(map);
+		return false;
+	}
+	for (unsigned i = 0; i < names.size(); i++)
+		map = isl_map_set_dim_name(map, isl_dim_in, i, names[i].c_str());
+	isl_pw_multi_aff *pma = isl_pw_multi_aff_from_map(map);
+	for (int i = 0; i < isl_pw_multi_aff_dim(pma, isl_dim_out); i++)
+		exprs.push_back(pw_aff_to_c(isl_pw_multi_aff_get_pw_aff(pma, i)));
+	isl_pw_multi_aff_free(pma);
+	return true;
+}
+
+// generated statement functions and their arguments are prefixed, so that
+// statement and iterator names cannot clash with the simulator code
+const string statement_prefix = "stmt_";
+const string iterator_prefix = "it_";
+
+isl_stat prefix_statement(isl_map *map, void *user)
+{
+	const char *name = isl_map_get_tuple_name(map, isl_dim_in);
+	map = isl_map_set_tuple_name(map, isl_dim_in, (statement_prefix + (name ? name : "")).c_str());
+	auto result = static_cast<isl_union_map**>(user);
+	*result = isl_union_map_add_map(*result, map);
+	return isl_stat_ok;
+}
+
+// rename the statements of a schedule to their functions, umap is freed
+isl_union_map *prefix_statements(isl_union_map *umap)
+{
+	isl_union_map *result = isl_union_map_empty(isl_union_map_get_space(umap));
+	isl_union_map_foreach_map(umap, prefix_statement, &result);
+	isl_union_map_free(umap);
+	return result;
+}
+
+string join(const vector<string>& items)
+{
+	string ret;
+	for (auto& item : items)
+		ret += (ret.empty() ? "" : ", ") + item;
+	return ret;
+}
+
+} // namespace
+
+string
+TENET::GenerateSimulator(Dataflow& df)
+{
+	const PEArray& pe = df.GetPEArray();
+	isl_union_set *pe_domain = pe.GetDomain();
+	isl_ctx *ctx = isl_union_set_get_ctx(pe_domain);
+	ostringstream out;
+
+	// PE box, linear PE index = row-major position in the box
+	vector<PointValue> pe_points = EvaluateOnPoints(isl_union_set_copy(pe_domain), {});
+	if (pe_points.empty())
+	{
+		isl_union_set_free(pe_domain);
+		return "";
+	}
+	unsigned pe_dims = pe_points[0].coords.size();
+	vector<long> lo = pe_points[0].coords, hi = lo;
+	for (auto& point : pe_points)
+		for (unsigned d = 0; d < pe_dims; d++)
+		{
+			lo[d] = min(lo[d], point.coords[d]);
+			hi[d] = max(hi[d], point.coords[d]);
+		}
+	auto index = [&](const long* coords)
+	{
+		long ret = 0;
+		for (unsigned d = 0; d < pe_dims; d++)
+			ret = ret * (hi[d] - lo[d] + 1) + coords[d] - lo[d];
+		return ret;
+	};
+	long pe_num = 1;
+	for (unsigned d = 0; d < pe_dims; d++)
+		pe_num *= hi[d] - lo[d] + 1;
+	vector<bool> valid(pe_num, false);
+	for (auto& point : pe_points)
+		valid[index(point.coords.data())] = true;
+	// links of the interconnect in CSR form
+	isl_union_map *interconnect = isl_union_map_intersect_range(
+		isl_union_map_intersect_domain(pe.GetInterconnect(), isl_union_set_copy(pe_domain)),
+		pe_domain);
+	vector<vector<long>> neighbors(pe_num);
+	for (auto& link : EvaluateOnPoints(isl_union_map_wrap(interconnect), {}))
+		neighbors[index(link.coords.data())].push_back(index(link.coords.data() + pe_dims));
+
+	// statements and tensors
+	vector<isl_set*> statements;
+	isl_union_set *domain = df.GetDomain();
+	isl_union_set_foreach_set(domain, collect_set, &statements);
+	isl_union_set_free(domain);
+	auto [input, output] = df.GetTensorList();
+	vector<pair<string, AccessType>> tensors;
+	for (auto& tensor : input)
+		tensors.emplace_back(tensor, AccessType::READ);
+	for (auto& tensor : output)
+		tensors.emplace_back(tensor, AccessType::WRITE);
+
+	ostringstream functions;
+	unsigned key_size = 1, time_dims = 0;
+	bool ok = true;
+	for (auto set : statements)
+	{
+		const char *statement = isl_set_get_tuple_name(set);
+		statement = statement ? statement : "";
+		vector<string> names;
+		for (int i = 0; i < isl_set_dim(set, isl_dim_set); i++)
+		{
+			const char *name = isl_set_get_dim_name(set, isl_dim_set, i);
+			names.push_back(iterator_prefix + (name ? name : to_string(i)));
+		}
+		vector<string> space, time;
+		if (ok && (!c_exprs(df.GetSpaceMap(), set, names, space) ||
+			!c_exprs(df.GetTimeMap(), set, names, time)))
+		{
+			fprintf(stderr, "The space or time map of %s is not single-valued\n", statement);
+			ok = false;
+		}
+		time_dims = max(time_dims, (unsigned)time.size());
+		functions << "static void " << statement_prefix << statement << "(";
+		for (unsigned i = 0; i < names.size(); i++)
+			functions << (i ? ", " : "") << "long " << names[i];
+		functions << ")\n{\n\tenter({" << join(time) << "});\n";
+		functions << "\tlong pe = pe_index({" << join(space) << "});\n";
+		for (unsigned t = 0; ok && t < tensors.size(); t++)
+		{
+			vector<string> index;
+			// e.g. a stencil reading A[i] and A[i+1] in one statement
+			if (!c_exprs(df.GetAccess(tensors[t].first, tensors[t].second), set, names, index))
+			{
+				fprintf(stderr, "%s accesses several elements of %s per instance, "
+					"which the simulator does not support\n", statement, tensors[t].first.c_str());
+				ok = false;
+			}
+			if (index.empty())
+				continue;
+			key_size = max(key_size, (unsigned)index.size() + 1);
+			functions << "\taccess(" << t << ", pe, {" << join(index) << "});\n";
+		}
+		functions << "}\n\n";
+		isl_set_free(set);
+	}
+	if (!ok)
+		return "";
+
+	// the loop nest runs the time dims first, then the PE dims, then the
+	// instances that share a PE and a time stamp
+	isl_union_map *schedule = prefix_statements(isl_union_map_flat_range_product(
+		isl_union_map_flat_range_product(df.GetTimeMap(), df.GetSpaceMap()),
+		isl_union_set_identity(df.GetDomain())));
+	isl_ast_build *build = isl_ast_build_from_context(isl_set_universe(isl_space_params_alloc(ctx, 0)));
+	isl_ast_node *tree = isl_ast_build_node_from_schedule_map(build, schedule);
+	isl_ast_build_free(build);
+	char *loops = isl_ast_node_to_C_str(tree);
+	isl_ast_node_free(tree);
+	if (loops == NULL)
+		return "";
+
+	out << "// generated by TENET from the dataflow\n";
+	out << "#define KEY_SIZE " << key_size << "\n";
+	out << "#define TIME_DIMS " << max(time_dims, 1u) << "\n";
+	out << "#define PE_NUM " << pe_num << "\n";
+	out << simulator_types << "\n";
+	vector<string> lo_str, extent_str;
+	for (unsigned d = 0; d < pe_dims; d++)
+	{
+		lo_str.push_back(to_string(lo[d]));
+		extent_str.push_back(to_string(hi[d] - lo[d] + 1));
+	}
+	out << "static const long pe_lo[] = {" << join(lo_str) << "};\n";
+	out << "static const long pe_extent[] = {" << join(extent_str) << "};\n";
+	out << "static const bool pe_valid[] = {";
+	for (long i = 0; i < pe_num; i++)
+		out << (i ? "," : "") << (valid[i] ? 1 : 0);
+	out << "};\nstatic const int neighbor_begin[] = {0";
+	long begin = 0;
+	for (auto& n : neighbors)
+		out << "," << (begin += n.size());
+	out << "};\nstatic const int neighbor[] = {";
+	bool first = true;
+	for (auto& n : neighbors)
+		for (long dst : n)
+		{
+			out << (first ? "" : ",") << dst;
+			first = false;
+		}
+	out << (first ? "-1" : "") << "};\n";
+	out << "static Counter counters[] = {\n";
+	for (auto& [tensor, type] : tensors)
+		out << "\t{\"" << tensor << "\", " << (type == AccessType::WRITE ? "true" : "false")
+			<< ", 0, 0, {}, {}},\n";
+	out << "};\n" << simulator_functions << "\n" << functions.str();
+	out << "int main()\n{\n" << loops << simulator_report;
+	free(loops);
+	return out.str();
+}
+
+bool
+TENET::WriteSimulator(Dataflow& df, const char* filename)
+{
+	string code = GenerateSimulator(df);
+	if (code.empty())
+		return false;
+	FILE* file = fopen(filename, "w");
+	if (file == NULL)
+		return false;
+	fputs(code.c_str(), file);
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,222 @@
+#include "context_manager.h"
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <isl/options.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace std;
+using namespace TENET;
+
+ContextManager::ContextManager(FILE* file, ContextLimits limits):
+	_file(file),
+	_limits(limits)
+{}
+
+namespace
+{
+
+// field of /proc/self/statm in bytes, 0 when it is unknown
+size_t read_statm(unsigned field)
+{
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm == NULL)
+		return 0;
+	unsigned long pages[2] = {0, 0};
+	int n = fscanf(statm, "%lu %lu", &pages[0], &pages[1]);
+	fclose(statm);
+	return n == 2 ? pages[field] * sysconf(_SC_PAGESIZE) : 0;
+}
+
+// address space left to the watchdog thread and the allocator arenas
+// besides the experiment under a hard cap
+const size_t HARD_CAP_SLACK_BYTES = size_t(256) << 20;
+
+// exit code of a forked experiment that could not report an allocation failure
+const int OUT_OF_MEMORY_EXIT = 3;
+
+// a bad_alloc nothing caught, e.g. on another thread of the experiment
+void terminate_out_of_memory()
+{
+	try
+	{
+		if (current_exception())
+			rethrow_exception(current_exception());
+	}
+	catch (const bad_alloc&)
+	{
+		_exit(OUT_OF_MEMORY_EXIT);
+	}
+	catch (...)
+	{}
+	abort();
+}
+
+} // namespace
+
+size_t
+ContextManager::GetResidentBytes()
+{
+	return read_statm(1);
+}
+
+void
+ContextManager::recycle()
+{
+	_context.reset();
+#ifdef __GLIBC__
+	// return the freed heap to the system, so the RSS tracks the new context
+	malloc_trim(0);
+#endif
+	_context = make_shared<ISL_Context>(_file);
+	// failed operations return NULL with a warning, an abort is told apart
+	// from the other errors by isl_ctx_last_error
+	isl_options_set_on_error(_context->ctx(), ISL_ON_ERROR_WARN);
+	_experiment_num = 0;
+	_context_num++;
+	_context_bytes = GetResidentBytes();
+}
+
+ExperimentResult
+ContextManager::Run(function<bool(shared_ptr<ISL_Context>)> experiment)
+{
+	if (!_context || (_limits.max_experiments && _experiment_num >= _limits.max_experiments) ||
+		(_limits.recycle_bytes && GetResidentBytes() > _context_bytes + _limits.recycle_bytes))
+		recycle();
+	_experiment_num++;
+	ExperimentResult result = _limits.max_experiment_bytes ?
+		run_forked(experiment) : run_watched(experiment);
+	if (!result.ok)
+		recycle();
+	return result;
+}
+
+ExperimentResult
+ContextManager::run_watched(function<bool(shared_ptr<ISL_Context>)>& experiment)
+{
+	isl_ctx *ctx = _context->ctx();
+	ExperimentResult result;
+	result.start_bytes = result.peak_bytes = GetResidentBytes();
+
+	mutex m;
+	condition_variable finished;
+	bool done = false;
+	thread watchdog([&]()
+	{
+		unique_lock<mutex> lock(m);
+		while (!finished.wait_for(lock, chrono::milliseconds(max(1u, _limits.poll_ms)), [&] { return done; }))
+		{
+			size_t bytes = GetResidentBytes();
+			result.peak_bytes = max(result.peak_bytes, bytes);
+			if (_limits.max_experiment_bytes && !result.out_of_memory &&
+				bytes > result.start_bytes + _limits.max_experiment_bytes)
+			{
+				result.out_of_memory = true;
+				isl_ctx_abort(ctx);
+			}
+		}
+	});
+	bool ok = false;
+	try
+	{
+		ok = experiment(_context);
+	}
+	catch (const bad_alloc&)
+	{
+		result.out_of_memory = true;
+	}
+	{
+		lock_guard<mutex> lock(m);
+		done = true;
+	}
+	finished.notify_one();
+	watchdog.join();
+
+	result.peak_bytes = max(result.peak_bytes, GetResidentBytes());
+	isl_error error = isl_ctx_last_error(ctx);
+	// isl_error_alloc is an allocation refused under the hard cap
+	if (error == isl_error_abort || error == isl_error_alloc)
+		result.out_of_memory = true;
+	result.ok = ok && error == isl_error_none && !result.out_of_memory;
+	isl_ctx_resume(ctx);
+	isl_ctx_reset_error(ctx);
+	return result;
+}
+
+/*
+* run_forked: isl only checks the abort flag in some operations, barvinok
+* counting never does, so the watchdog alone cannot stop every runaway
+* experiment. The child running it has an address space limit of
+* max_experiment_bytes above its size at fork, so an allocation past it fails.
+* Only failed allocations count as out of memory, a child that dies in any
+* other way without reporting its result is a plain failure.
+*/
+ExperimentResult
+ContextManager::run_forked(function<bool(shared_ptr<ISL_Context>)>& experiment)
+{
+	ExperimentResult result;
+	result.start_bytes = result.peak_bytes = GetResidentBytes();
+	int fds[2];
+	fflush(NULL);
+	if (pipe(fds) != 0)
+	{
+		fprintf(stderr, "pipe failed, running the experiment without a hard memory cap\n");
+		return run_watched(experiment);
+	}
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		fprintf(stderr, "fork failed, running the experiment without a hard memory cap\n");
+		return run_watched(experiment);
+	}
+	if (pid == 0)
+	{
+		close(fds[0]);
+		struct rlimit limit;
+		size_t cap = read_statm(0) + _limits.max_experiment_bytes + HARD_CAP_SLACK_BYTES;
+		if (getrlimit(RLIMIT_AS, &limit) == 0 && (limit.rlim_max == RLIM_INFINITY || cap < limit.rlim_max))
+		{
+			limit.rlim_cur = cap;
+			setrlimit(RLIMIT_AS, &limit);
+		}
+		set_terminate(terminate_out_of_memory);
+		ExperimentResult child = run_watched(experiment);
+		fflush(NULL);
+		ssize_t written = write(fds[1], &child, sizeof(child));
+		_exit(written == sizeof(child) ? 0 : (child.out_of_memory ? OUT_OF_MEMORY_EXIT : 1));
+	}
+	close(fds[1]);
+	ExperimentResult child;
+	size_t received = 0;
+	while (received < sizeof(child))
+	{
+		ssize_t n = read(fds[0], reinterpret_cast<char*>(&child) + received, sizeof(child) - received);
+		if (n <= 0)
+			break;
+		received += n;
+	}
+	close(fds[0]);
+	int status = 0;
+	if (waitpid(pid, &status, 0) < 0)
+		status = -1;
+	if (received == sizeof(child))
+		return child;
+	// a crash of the experiment is a failure, not a memory cap hit
+	if (WIFEXITED(status) && WEXITSTATUS(status) == OUT_OF_MEMORY_EXIT)
+		result.out_of_memory = true;
+	else if (WIFSIGNALED(status))
+		fprintf(stderr, "experiment killed by signal %d\n", WTERMSIG(status));
+	else
+		fprintf(stderr, "experiment exited without a result (status %d)\n",
+			WIFEXITED(status) ? WEXITSTATUS(status) : status);
+	return result;
+}
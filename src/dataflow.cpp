@@ -1,14 +1,49 @@
 #include "dataflow.h"
+#include "parallel.h"
 
 using namespace std;
 using namespace TENET;
 
+double
+TENET::transfer_delay(double bits, unsigned bandwidth, unsigned avg_latency)
+{
+	if (bits <= 0)
+		return 0;
+	return floor(bits / bandwidth) + avg_latency - 1;
+}
+
 Dataflow::Dataflow(Statement &&st, PEArray &&pe, Mapping &&mp):
 	_st(move(st)),
 	_pe(move(pe)),
 	_mp(move(mp))
 {}
 
+DataflowText
+Dataflow::Serialize() const
+{
+	return DataflowText{_st.Serialize(), _pe.Serialize(), _mp.Serialize()};
+}
+
+unique_ptr<Dataflow>
+Dataflow::Deserialize(shared_ptr<ISL_Context> context, const DataflowText& text)
+{
+	Statement st(context);
+	PEArray pe(context);
+	Mapping mp(context);
+	istringstream st_input(text.statement), pe_input(text.pe_array), mp_input(text.mapping);
+	if (!st.Load(st_input) || !pe.Load(pe_input) || !mp.Load(mp_input))
+		return nullptr;
+	return make_unique<Dataflow>(move(st), move(pe), move(mp));
+}
+
+Dataflow
+Dataflow::Restrict(isl_union_set *instances) const
+{
+	Statement st = _st.copy();
+	st.IntersectDomain(instances);
+	return Dataflow(move(st), _pe.copy(), _mp.copy());
+}
+
 isl_union_map*
 Dataflow::GetSpaceMap()
 {
@@ -47,6 +82,52 @@ Dataflow::GetAccess(
 	return _st.GetAccess(tensor_name, type);
 }
 
+vector<string>
+Dataflow::select_tensors(string tensor_name, AccessType type) const
+{
+	if (tensor_name != "")
+		return {tensor_name};
+	auto [input, output] = _st.GetTensorList();
+	vector<string> ret;
+	if (type == AccessType::READ || type == AccessType::READ_OR_WRITE)
+		ret = input;
+	if (type == AccessType::WRITE || type == AccessType::READ_OR_WRITE)
+		for (auto& tensor : output)
+			if (find(ret.begin(), ret.end(), tensor) == ret.end())
+				ret.push_back(tensor);
+	return ret;
+}
+
+/*
+* weighted_sum: volume is evaluated once for all tensors when they have the
+* same weight, and once for every tensor otherwise
+*/
+template<class Weight, class Fn>
+double
+Dataflow::weighted_sum(string tensor_name, AccessType type, Weight weight, Fn volume)
+{
+	auto tensors = select_tensors(tensor_name, type);
+	if (tensors.empty())
+		return 0;
+	double w = weight(tensors[0]);
+	bool uniform = all_of(tensors.begin(), tensors.end(),
+		[&](auto& tensor) { return weight(tensor) == w; });
+	if (uniform)
+		return volume(tensor_name) * w;
+	double ret = 0;
+	for (auto& tensor : tensors)
+		ret += volume(tensor) * weight(tensor);
+	return ret;
+}
+
+template<class Fn>
+double
+Dataflow::bits_sum(string tensor_name, AccessType type, Fn volume)
+{
+	return weighted_sum(tensor_name, type,
+		[&](const string& tensor) { return GetBitsPerItem(tensor, type); }, volume);
+}
+
 isl_union_set*
 Dataflow::GetSpaceDomain()
 {
@@ -156,6 +237,21 @@ Dataflow::MapSpaceTimeToAccess(string tensor_name, AccessType type)
 	return isl_union_map_apply_range(space_time_to_domain, access);
 }
 /*
+* MapSpaceTimeToUniqueAccess: the accesses of each space-time point that
+* cannot be found from its neighbors in space-time domain
+*/
+isl_union_map *
+Dataflow::MapSpaceTimeToUniqueAccess(
+	string tensor_name,
+	AccessType type,
+	isl_union_map *space_time_to_neighbor)
+{
+	isl_union_map *access = MapSpaceTimeToAccess(tensor_name, type);
+	isl_union_map *neighbor_access = isl_union_map_apply_range(space_time_to_neighbor,
+		isl_union_map_copy(access));
+	return isl_union_map_subtract(access, neighbor_access);
+}
+/*
 * GetUniqueVolume: the size of data required that cannot be find from
 * neighbor in space-time domain
 */
@@ -165,10 +261,11 @@ Dataflow::GetUniqueVolume(
 	AccessType type,
 	isl_union_map *space_time_to_neighbor)
 {
-	isl_union_map *access = MapSpaceTimeToAccess(tensor_name, type);
-	isl_union_map *neighbor_access = isl_union_map_apply_range(space_time_to_neighbor,
-		isl_union_map_copy(access));
-	isl_union_map *unique_access = isl_union_map_subtract(access, neighbor_access);
+	isl_union_map *unique_access =
+		MapSpaceTimeToUniqueAccess(tensor_name, type, space_time_to_neighbor);
+	// PEs of a multicast group share one fetch per cycle
+	if (type == AccessType::READ && _pe.HasMulticast())
+		unique_access = isl_union_map_apply_domain(unique_access, MapSpaceTimeToMulticastGroup());
 	isl_union_pw_qpolynomial *unique_access_num = isl_union_map_card(unique_access);
 #ifdef DEBUG
 	fprintf(stdout,"Unique Access Num for %s:\n",tensor_name.c_str());
@@ -180,6 +277,53 @@ Dataflow::GetUniqueVolume(
 
 	return convert_upwqp_to_int(unique_access_num);
 }
+/*
+* MapSpaceTimeToMulticastGroup: [PE->T] -> [group->T], PEs outside any
+* multicast group form a group of their own
+*/
+isl_union_map *
+Dataflow::MapSpaceTimeToMulticastGroup()
+{
+	isl_union_map *multicast = _pe.GetMulticast();
+	isl_union_map *group = isl_union_set_identity(GetSpaceDomain());
+	if (multicast != NULL)
+	{
+		isl_union_set *single = isl_union_set_subtract(GetSpaceDomain(),
+			isl_union_map_domain(isl_union_map_copy(multicast)));
+		group = isl_union_map_union(
+			isl_union_map_intersect_domain(multicast, GetSpaceDomain()),
+			isl_union_map_intersect_domain(group, single));
+	}
+	return isl_union_map_intersect_domain(
+		isl_union_map_product(group, isl_union_set_identity(GetTimeDomain())),
+		GetSpaceTimeDomain());
+}
+
+/*
+* GetMulticastFanout: the number of deliveries from multicast groups to
+* their PEs, i.e. the per-PE unique volume, 0 without multicast
+*/
+double
+Dataflow::GetMulticastFanout(string tensor_name, isl_union_map *space_time_to_neighbor)
+{
+	if (!_pe.HasMulticast())
+	{
+		isl_union_map_free(space_time_to_neighbor);
+		return 0;
+	}
+	isl_union_map *multicast = _pe.GetMulticast();
+	// space-time points of PEs in a multicast group
+	isl_union_set *grouped = isl_union_map_wrap(isl_union_map_intersect_domain(
+		isl_union_set_unwrap(GetSpaceTimeDomain()), isl_union_map_domain(multicast)));
+	isl_union_map *unique_access = isl_union_map_intersect_domain(
+		MapSpaceTimeToUniqueAccess(tensor_name, AccessType::READ, space_time_to_neighbor),
+		grouped);
+	isl_union_pw_qpolynomial *unique_access_num = isl_union_map_card(unique_access);
+	unique_access_num = isl_union_pw_qpolynomial_sum(unique_access_num); // sum on time
+	unique_access_num = isl_union_pw_qpolynomial_sum(unique_access_num); // sum on space
+	return convert_upwqp_to_int(unique_access_num);
+}
+
 /*
 * GetTotalVolume: the size of data required in total when no data reuse
 * is considered
@@ -193,6 +337,19 @@ Dataflow::GetTotalVolume(string tensor_name, AccessType type)
 	return convert_upwqp_to_int(access_num);
 }
 
+/*
+* GetFootprint: the number of distinct tensor elements touched by the
+* statement, i.e. the traffic between L2 and off-chip memory when every
+* element is brought on chip exactly once
+*/
+double
+Dataflow::GetFootprint(string tensor_name, AccessType type)
+{
+	isl_union_set *elements = isl_union_map_range(GetAccess(tensor_name, type));
+	isl_union_pw_qpolynomial *element_num = isl_union_set_card(elements);
+	return convert_upwqp_to_int(element_num);
+}
+
 double
 Dataflow::GetTemporalReuseVolume(string tensor_name, AccessType type)
 {
@@ -225,6 +382,72 @@ Dataflow::GetSpatialReuseVolume(string tensor_name, AccessType type, isl_union_m
 	double res = number / dsize;
 	return res;
 }
+/*
+* Expected metrics of sparse tensors: an instance is effectual when all its
+* input elements are nonzero, which are assumed to be independent. Only
+* effectual instances do their MACs and access their tensors, so the accesses
+* of a tensor scale with its own density and the density of its co-operands.
+* A fetch serves total / unique accesses on average and is needed when any of
+* them is effectual. Nonzero blocks of a block sparse tensor are fetched whole.
+*/
+double
+Dataflow::co_density(string tensor_name) const
+{
+	double density = 1;
+	for (auto& tensor : select_tensors("", AccessType::READ))
+		if (tensor != tensor_name)
+			density *= GetDensity(tensor);
+	return density;
+}
+
+double
+Dataflow::GetExpectedUniqueVolume(
+	string tensor_name,
+	AccessType type,
+	isl_union_map *space_time_to_neighbor)
+{
+	double volume = 0;
+	for (auto& tensor : select_tensors(tensor_name, type))
+	{
+		auto shape = _st.GetBlockShape(tensor);
+		double unique = shape.empty() ?
+			GetUniqueVolume(tensor, type, isl_union_map_copy(space_time_to_neighbor)) :
+			block_unique_volume(tensor, type, isl_union_map_copy(space_time_to_neighbor), shape);
+		double total = GetTotalVolume(tensor, type);
+		double co = co_density(tensor);
+		double needed = unique > 0 && co < 1 ? 1 - pow(1 - co, total / unique) : 1;
+		volume += GetDensity(tensor) * needed * unique;
+	}
+	isl_union_map_free(space_time_to_neighbor);
+	return volume;
+}
+
+double
+Dataflow::GetExpectedTotalVolume(string tensor_name, AccessType type)
+{
+	return weighted_sum(tensor_name, type,
+		[&](const string& tensor) { return GetDensity(tensor) * co_density(tensor); },
+		[&](string tensor) { return GetTotalVolume(tensor, type); });
+}
+
+double
+Dataflow::GetExpectedReuseFactor(string tensor_name, AccessType type,
+	isl_union_map* space_time_to_neighbor)
+{
+	double unique_volume = GetExpectedUniqueVolume(tensor_name, type, space_time_to_neighbor);
+	double total_volume = GetExpectedTotalVolume(tensor_name, type);
+	return total_volume / unique_volume;
+}
+
+double
+Dataflow::GetExpectedMacNum(int mac_per_instance)
+{
+	double mac_num = GetMacNum(mac_per_instance);
+	for (auto& tensor : select_tensors("", AccessType::READ))
+		mac_num *= GetDensity(tensor);
+	return mac_num;
+}
+
 /*
 * GetReuseFactor: calculate reuse factor by TotalVolume/UniqueVolume
 */
@@ -238,21 +461,6 @@ Dataflow::GetReuseFactor(string tensor_name, AccessType type,
 	return reuse_factor;
 }
 
-// this function is used to convert a union piecewise quasi-polynomial function that
-// HAVE A EMPTY DOMAIN (that is, only have a value) to int 
-// upwqp is freed by this function.
-double
-Dataflow::convert_upwqp_to_int(isl_union_pw_qpolynomial *upwqp)
-{
-	isl_printer *p = isl_printer_to_str(isl_union_pw_qpolynomial_get_ctx(upwqp));
-	p = isl_printer_set_output_format(p, ISL_FORMAT_ISL);
-	p = isl_printer_print_union_pw_qpolynomial(p, upwqp);
-	char *s = isl_printer_get_str(p);
-	double ret = atoi(s + 1);
-	isl_union_pw_qpolynomial_free(upwqp);
-	isl_printer_free(p);
-	return ret;
-}
 double
 Dataflow::GetDomainSize()
 {
@@ -297,6 +505,74 @@ Dataflow::GetMacNumPerPE(int mac_per_instance)
 	return mac_num / dsize;
 }
 
+isl_union_pw_qpolynomial*
+Dataflow::GetMacNumMap(int mac_per_instance)
+{
+	isl_union_map *pe_to_domain = isl_union_map_reverse(GetSpaceMap());
+	isl_val *v = isl_val_int_from_si(isl_union_map_get_ctx(pe_to_domain), mac_per_instance);
+	isl_union_pw_qpolynomial *mac_num = isl_union_map_card(pe_to_domain);
+	return isl_union_pw_qpolynomial_scale_val(mac_num, v);
+}
+
+PEWorkload
+Dataflow::GetPEWorkload(int mac_per_instance)
+{
+	PEWorkload workload;
+	isl_union_pw_qpolynomial *mac_num = GetMacNumMap(mac_per_instance);
+	double pe_num = GetPENum();
+	workload.average = pe_num > 0 ? GetMacNum(mac_per_instance) / pe_num : 0;
+	if (pe_num > MAX_ENUMERATED_POINTS)
+	{
+		workload.max = convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+			isl_union_pw_qpolynomial_copy(mac_num), isl_fold_max, NULL));
+		workload.min = convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+			mac_num, isl_fold_min, NULL));
+		return workload;
+	}
+	auto points = EvaluateOnPoints(GetSpaceDomain(), {mac_num});
+	for (unsigned i = 0; i < points.size(); i++)
+	{
+		double v = points[i].values[0];
+		workload.max = i == 0 ? v : max(workload.max, v);
+		workload.min = i == 0 ? v : min(workload.min, v);
+		workload.histogram[v]++;
+	}
+	return workload;
+}
+
+bool
+Dataflow::WritePEUtilization(const char* filename)
+{
+	if (convert_upwqp_to_int(isl_union_set_card(_pe.GetDomain())) > MAX_ENUMERATED_POINTS)
+	{
+		fprintf(stderr, "Too many PEs to write the utilization of\n");
+		return false;
+	}
+	FILE *file = fopen(filename, "w");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Open file %s failed\n", filename);
+		return false;
+	}
+	// every instance occupies its PE for one time step
+	double total_time = GetTotalTime();
+	auto points = EvaluateOnPoints(_pe.GetDomain(), {GetMacNumMap()});
+	for (unsigned i = 0; i < points.size(); i++)
+	{
+		auto &coords = points[i].coords;
+		bool new_row = i > 0 && !equal(coords.begin(), coords.end() - 1,
+			points[i - 1].coords.begin());
+		if (new_row)
+			fprintf(file, "\n");
+		else if (i > 0)
+			fprintf(file, ",");
+		fprintf(file, "%.3f", total_time > 0 ? points[i].values[0] / total_time : 0);
+	}
+	fprintf(file, "\n");
+	fclose(file);
+	return true;
+}
+
 double
 Dataflow::GetActivePENum()
 {
@@ -320,119 +596,1485 @@ Dataflow::GetAverageActivePENum()
 	return avg_active_pe;
 }
 
+double
+Dataflow::unique_bits(string tensor_name, AccessType type, isl_union_map* space_time_to_neighbor)
+{
+	double bits = bits_sum(tensor_name, type, [&](string tensor) {
+		return GetUniqueVolume(tensor, type, isl_union_map_copy(space_time_to_neighbor));
+	});
+	isl_union_map_free(space_time_to_neighbor);
+	return bits;
+}
+
+double
+Dataflow::combine_delay(double ingress_bits, double egress_bits, double compute_delay)
+{
+	double ingress_delay = transfer_delay(ingress_bits, _pe.GetBandwidth(), _pe.GetAvgLatency());
+	double egress_delay = transfer_delay(egress_bits, _pe.GetBandwidth(), _pe.GetAvgLatency());
+	return max(max(ingress_delay, egress_delay), compute_delay);
+}
+
 double
 Dataflow::GetIngressDelay(isl_union_map* space_time_to_neighbor, string tensor_name)
 {
-	long long ingress_volume =
-		GetUniqueVolume(tensor_name, AccessType::READ, space_time_to_neighbor)*BIT_PER_ITEM;
-	return ingress_volume / _pe.GetBandwidth() + _pe.GetAvgLatency() - 1;
+	return transfer_delay(unique_bits(tensor_name, AccessType::READ, space_time_to_neighbor),
+		_pe.GetBandwidth(), _pe.GetAvgLatency());
 }
 
 double
 Dataflow::GetEgressDelay(isl_union_map* space_time_to_neighbor, string tensor_name)
 {
-	long long egress_volume =
-		GetUniqueVolume(tensor_name, AccessType::WRITE, space_time_to_neighbor)*BIT_PER_ITEM;
-	return egress_volume / _pe.GetBandwidth() + _pe.GetAvgLatency() - 1;
+	return transfer_delay(unique_bits(tensor_name, AccessType::WRITE, space_time_to_neighbor),
+		_pe.GetBandwidth(), _pe.GetAvgLatency());
+}
+
+/*
+* GetReduction: the root of each adder tree is its lexicographically first PE.
+* After the spatial reduction an element that the root keeps accumulating in
+* place over time leaves the array once.
+*/
+Reduction
+Dataflow::GetReduction(string tensor_name, unsigned adder_latency)
+{
+	Reduction ret;
+	isl_union_map *access = MapSpaceTimeToAccess(tensor_name, AccessType::WRITE);
+	// [T->tensor] -> PE
+	isl_union_map *contributor = isl_union_map_reverse(isl_union_map_curry(access));
+	isl_union_pw_qpolynomial *fanin = isl_union_map_card(isl_union_map_copy(contributor));
+	ret.max_fanin = convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+		isl_union_pw_qpolynomial_copy(fanin), isl_fold_max, NULL));
+	ret.depth = ret.max_fanin > 1 ? (unsigned)ceil(log2(ret.max_fanin)) : 0;
+	ret.latency = ret.depth * adder_latency;
+	fanin = isl_union_pw_qpolynomial_sum(fanin); // sum on tensor
+	fanin = isl_union_pw_qpolynomial_sum(fanin); // sum on time
+	double reduced_num = convert_upwqp_to_int(
+		isl_union_set_card(isl_union_map_domain(isl_union_map_copy(contributor))));
+	ret.add_num = convert_upwqp_to_int(fanin) - reduced_num;
+
+	// [root->T] -> tensor
+	isl_union_map *reduced = isl_union_map_uncurry(
+		isl_union_map_reverse(isl_union_map_lexmin(contributor)));
+	isl_union_map *prev = MapSpaceTimeToNeighbor(0, false, 1, true, false);
+	isl_union_map *egress = isl_union_map_subtract(isl_union_map_copy(reduced),
+		isl_union_map_apply_range(prev, isl_union_map_copy(reduced)));
+	isl_union_map_free(reduced);
+	isl_union_pw_qpolynomial *egress_num = isl_union_map_card(egress);
+	egress_num = isl_union_pw_qpolynomial_sum(egress_num); // sum on time
+	egress_num = isl_union_pw_qpolynomial_sum(egress_num); // sum on space
+	ret.egress_volume = convert_upwqp_to_int(egress_num);
+	return ret;
+}
+
+double
+Dataflow::GetReductionEgressDelay(string tensor_name, unsigned adder_latency)
+{
+	double egress_bits = 0, latency = 0;
+	for (auto& tensor : select_tensors(tensor_name, AccessType::WRITE))
+	{
+		Reduction reduction = GetReduction(tensor, adder_latency);
+		egress_bits += reduction.egress_volume * GetBitsPerItem(tensor, AccessType::WRITE);
+		latency = max(latency, reduction.latency);
+	}
+	return transfer_delay(egress_bits, _pe.GetBandwidth(), _pe.GetAvgLatency()) + latency;
 }
 
 double
 Dataflow::GetComputationDelay()
 {
-	return GetMacNumPerPE();
+	// the MACs of the busiest PE, bounded without enumerating the PEs
+	return convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+		GetMacNumMap(), isl_fold_max, NULL));
 }
 
 double
 Dataflow::GetDelay(isl_union_map* space_time_to_neighbor)
 {
-	// int max_delay = 0;
-	double ingress_delay = GetIngressDelay(isl_union_map_copy(space_time_to_neighbor));
-	double egress_delay = GetEgressDelay(space_time_to_neighbor);
-	double compute_delay = GetComputationDelay();
+	double ingress_bits = unique_bits("", AccessType::READ, isl_union_map_copy(space_time_to_neighbor));
+	double egress_bits = unique_bits("", AccessType::WRITE, space_time_to_neighbor);
+	return combine_delay(ingress_bits, egress_bits, GetComputationDelay());
+}
+
+namespace
+{
 
-	return max(max(ingress_delay, egress_delay), compute_delay);
+struct TileArgs
+{
+	unsigned tile_dims;
+	isl_union_map *result;
+};
+
+isl_stat time_to_tile(isl_set *set, void *user)
+{
+	auto args = static_cast<TileArgs*>(user);
+	int n = isl_set_dim(set, isl_dim_set);
+	isl_map *map = isl_map_identity(isl_space_map_from_set(isl_set_get_space(set)));
+	if (args->tile_dims < (unsigned)n)
+		map = isl_map_project_out(map, isl_dim_out, args->tile_dims, n - args->tile_dims);
+	map = isl_map_intersect_domain(map, set);
+	args->result = isl_union_map_add_map(args->result, map);
+	return isl_stat_ok;
 }
 
-double
-Dataflow::GetL1Read(string tensor_name, AccessType type)
+isl_stat flatten_set(isl_set *set, void *user)
 {
-	if (type == AccessType::READ || type == AccessType::WRITE)
-		return GetTotalVolume(tensor_name, type);
-	else
-		// for tensor that both be input and output, one L1 read for L1->PE and one for L1->L2
-		return GetTotalVolume(tensor_name, AccessType::READ) + GetTotalVolume(tensor_name, AccessType::WRITE);
+	auto result = static_cast<isl_union_map**>(user);
+	*result = isl_union_map_add_map(*result, isl_set_flatten_map(set));
+	return isl_stat_ok;
 }
 
-double
-Dataflow::GetL1Write(string tensor_name, AccessType type)
+// map every wrapped point [A->B] of uset to the flat point [A,B], so that
+// bounds are taken over all its dimensions
+isl_union_map *flatten(isl_union_set *uset)
 {
-	if (type == AccessType::READ || type == AccessType::WRITE)
-		return GetTotalVolume(tensor_name, type);
-	else
-		// for tensor that both be input and output, one L1 write for L2->L1 and one for PE->L1
-		return GetTotalVolume(tensor_name, AccessType::READ) + GetTotalVolume(tensor_name, AccessType::WRITE);
+	isl_union_map *result = isl_union_map_empty(isl_union_set_get_space(uset));
+	isl_union_set_foreach_set(uset, flatten_set, &result);
+	isl_union_set_free(uset);
+	return result;
 }
 
-double
-Dataflow::GetL2Read(
-	string tensor_name,
-	AccessType type,
-	isl_union_map* space_time_to_neighbor)
+// max number of elements live at the same point of the domain of
+// live (point -> element), live is freed
+double max_live(isl_union_map *live)
 {
-	if (type == AccessType::READ || type == AccessType::WRITE)
-		// reuse can be exploited  to reduce L2 read
-		return GetUniqueVolume(tensor_name, type, space_time_to_neighbor);
-	else
-		// for tensor that both be input and output, one L2 read for L2->L1 and one for L2->DRAM
-		return GetUniqueVolume( tensor_name, AccessType::READ,
-					isl_union_map_copy(space_time_to_neighbor)
-				) + GetUniqueVolume(tensor_name, AccessType::WRITE, space_time_to_neighbor);
+	live = isl_union_map_apply_domain(live,
+		flatten(isl_union_map_domain(isl_union_map_copy(live))));
+	return convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+		isl_union_map_card(live), isl_fold_max, NULL));
+}
+
+// element is live in [first use, last use] given use (element -> time),
+// returns element -> time where it is live, use is freed
+isl_union_map *live_range(isl_union_map *use, isl_union_set *time_domain)
+{
+	isl_union_map *time = isl_union_set_identity(time_domain);
+	isl_union_map *after_first = isl_union_map_lex_le_union_map(
+		isl_union_map_lexmin(isl_union_map_copy(use)), isl_union_map_copy(time));
+	isl_union_map *before_last = isl_union_map_lex_ge_union_map(
+		isl_union_map_lexmax(use), time);
+	return isl_union_map_intersect(after_first, before_last);
+}
+
+// map every point of uset to the lexicographically previous point
+isl_union_map *map_to_prev(isl_union_set *uset)
+{
+	isl_union_map *prev = isl_union_set_lex_gt_union_set(isl_union_set_copy(uset), uset);
+	return isl_union_map_lexmax(prev);
+}
+
+isl_stat get_set_dim(isl_set *set, void *user)
+{
+	*static_cast<unsigned*>(user) = isl_set_dim(set, isl_dim_set);
+	isl_set_free(set);
+	return isl_stat_ok;
+}
+
+// number of dims of the sets in uset, which all have the same dims
+unsigned set_dim(isl_union_set *uset)
+{
+	unsigned n = 0;
+	isl_union_set_foreach_set(uset, get_set_dim, &n);
+	isl_union_set_free(uset);
+	return n;
+}
+
+// number of [[PE->T]->tensor] pairs in a space-time access map
+double access_num(isl_union_map *access)
+{
+	isl_union_pw_qpolynomial *num = isl_union_map_card(access);
+	num = isl_union_pw_qpolynomial_sum(num); // sum on time
+	num = isl_union_pw_qpolynomial_sum(num); // sum on space
+	return convert_upwqp_to_int(num);
+}
+
+// multiply by a factor given with three decimals, e.g. bits * compression
+isl_union_pw_qpolynomial *scale(isl_union_pw_qpolynomial *upwqp, double factor)
+{
+	isl_ctx *ctx = isl_union_pw_qpolynomial_get_ctx(upwqp);
+	isl_val *v = isl_val_div(isl_val_int_from_si(ctx, llround(factor * 1000)),
+		isl_val_int_from_si(ctx, 1000));
+	return isl_union_pw_qpolynomial_scale_val(upwqp, v);
+}
+
+isl_stat collect_point(isl_point *pnt, void *user)
+{
+	static_cast<vector<isl_union_set*>*>(user)->push_back(isl_union_set_from_point(pnt));
+	return isl_stat_ok;
+}
+
+// every point of a small set as its own set, uset is freed
+vector<isl_union_set*> collect_points(isl_union_set *uset)
+{
+	vector<isl_union_set*> points;
+	isl_union_set_foreach_point(uset, collect_point, &points);
+	isl_union_set_free(uset);
+	return points;
+}
+
+struct BlockArgs
+{
+	const vector<unsigned> *shape;
+	isl_union_map *result;
+};
+
+isl_stat element_to_block(isl_set *set, void *user)
+{
+	auto args = static_cast<BlockArgs*>(user);
+	int n = isl_set_dim(set, isl_dim_set);
+	isl_multi_aff *to_block = isl_multi_aff_identity(isl_space_map_from_set(isl_set_get_space(set)));
+	for (int i = 0; i < n && i < (int)args->shape->size(); i++)
+	{
+		isl_aff *aff = isl_multi_aff_get_aff(to_block, i);
+		aff = isl_aff_floor(isl_aff_scale_down_ui(aff, (*args->shape)[i]));
+		to_block = isl_multi_aff_set_aff(to_block, i, aff);
+	}
+	isl_map *map = isl_map_intersect_domain(isl_map_from_multi_aff(to_block), set);
+	args->result = isl_union_map_add_map(args->result, map);
+	return isl_stat_ok;
 }
 
+// map every element to the block of the given shape it is in, elements is freed
+isl_union_map *map_to_block(isl_union_set *elements, const vector<unsigned>& shape)
+{
+	BlockArgs args{&shape, isl_union_map_empty(isl_union_set_get_space(elements))};
+	isl_union_set_foreach_set(elements, element_to_block, &args);
+	isl_union_set_free(elements);
+	return args.result;
+}
+
+} // namespace
+
+/*
+* block_unique_volume: GetUniqueVolume where an element is found from a
+* neighbor that accessed any element of its block, and every block fetched
+* is moved whole
+*/
 double
-Dataflow::GetL2Write(
+Dataflow::block_unique_volume(
 	string tensor_name,
 	AccessType type,
-	isl_union_map* space_time_to_neighbor)
+	isl_union_map *space_time_to_neighbor,
+	const vector<unsigned>& shape)
 {
-	if (type == AccessType::READ || type == AccessType::WRITE)
-		// reuse can be exploited to reduce L2 write
-		return GetUniqueVolume(tensor_name, type, space_time_to_neighbor);
-	else
-		// for tensor that both be input and output, one L2 write for DRAM->L2 and one for L1->L2
-		return GetUniqueVolume(tensor_name, AccessType::READ, isl_union_map_copy(space_time_to_neighbor)) +
-		GetUniqueVolume(tensor_name, AccessType::WRITE, space_time_to_neighbor);
+	isl_union_map *access = isl_union_map_apply_range(MapSpaceTimeToAccess(tensor_name, type),
+		map_to_block(isl_union_map_range(GetAccess(tensor_name, type)), shape));
+	isl_union_map *neighbor_access = isl_union_map_apply_range(space_time_to_neighbor,
+		isl_union_map_copy(access));
+	isl_union_map *unique_access = isl_union_map_subtract(access, neighbor_access);
+	if (type == AccessType::READ && _pe.HasMulticast())
+		unique_access = isl_union_map_apply_domain(unique_access, MapSpaceTimeToMulticastGroup());
+	double block_size = 1;
+	for (unsigned size : shape)
+		block_size *= size;
+	return access_num(unique_access) * block_size;
 }
 
-double
-Dataflow::GetEnergy(isl_union_map* space_time_to_neighbor)
+template<class Fn>
+isl_union_pw_qpolynomial *
+Dataflow::bits_fn(string tensor_name, AccessType type, Fn volume)
 {
-	double energy = GetMacNum();  // energy cost of MAC
-	auto [input, output] = _st.GetTensorList();
-	for (auto& iter : input)
+	auto tensors = select_tensors(tensor_name, type);
+	double bits = tensors.empty() ? BIT_PER_ITEM : GetBitsPerItem(tensors[0], type);
+	bool uniform = all_of(tensors.begin(), tensors.end(),
+		[&](auto& tensor) { return GetBitsPerItem(tensor, type) == bits; });
+	if (uniform)
+		return scale(volume(tensor_name), bits);
+	isl_union_pw_qpolynomial *ret = NULL;
+	for (auto& tensor : tensors)
 	{
-		energy += l1_multiplier * GetL1Read(iter, AccessType::READ);
-		energy += l1_multiplier * GetL1Write(iter, AccessType::READ);
-		energy += l2_multiplier * GetL2Read(iter, AccessType::READ,
-			isl_union_map_copy(space_time_to_neighbor));
-		energy += l2_multiplier * GetL2Write(iter, AccessType::READ,
-			isl_union_map_copy(space_time_to_neighbor));
+		isl_union_pw_qpolynomial *v = scale(volume(tensor), GetBitsPerItem(tensor, type));
+		ret = ret == NULL ? v : isl_union_pw_qpolynomial_add(ret, v);
 	}
-	for (auto& iter:output)
+	return ret;
+}
+
+isl_union_map *
+Dataflow::MapTimeToTile(unsigned tile_dims)
+{
+	isl_union_set *time_domain = GetTimeDomain();
+	TileArgs args{tile_dims, isl_union_map_empty(isl_union_set_get_space(time_domain))};
+	isl_union_set_foreach_set(time_domain, time_to_tile, &args);
+	isl_union_set_free(time_domain);
+	return args.result;
+}
+
+double
+Dataflow::tile_num(unsigned tile_dims)
+{
+	isl_union_set *tiles = isl_union_set_apply(GetTimeDomain(), MapTimeToTile(tile_dims));
+	return convert_upwqp_to_int(isl_union_set_card(tiles));
+}
+
+/*
+* GetTileUniqueVolume: the unique volume as a function of the tile,
+* i.e. the data that has to be moved in while the tile is executed
+*/
+isl_union_pw_qpolynomial *
+Dataflow::GetTileUniqueVolume(
+	string tensor_name,
+	AccessType type,
+	isl_union_map *space_time_to_neighbor,
+	unsigned tile_dims)
+{
+	isl_union_map *unique_access =
+		MapSpaceTimeToUniqueAccess(tensor_name, type, space_time_to_neighbor);
+	isl_union_set *space_time = GetSpaceTimeDomain();
+	if (type == AccessType::READ && _pe.HasMulticast())
 	{
-		energy += l1_multiplier * GetL1Read(iter, AccessType::WRITE);
-		energy += l1_multiplier * GetL1Write(iter, AccessType::WRITE);
-		energy += l2_multiplier * GetL2Read(iter, AccessType::WRITE,
-			isl_union_map_copy(space_time_to_neighbor));
-		energy += l2_multiplier * GetL2Write(iter, AccessType::WRITE,
-			isl_union_map_copy(space_time_to_neighbor));
+		isl_union_map *group = MapSpaceTimeToMulticastGroup();
+		unique_access = isl_union_map_apply_domain(unique_access, isl_union_map_copy(group));
+		space_time = isl_union_set_apply(space_time, group);
 	}
-	isl_union_map_free(space_time_to_neighbor);
-	return energy;
+	// [PE->T] -> T -> tile
+	isl_union_map *space_time_to_tile = isl_union_map_apply_range(
+		isl_union_map_range_map(isl_union_set_unwrap(space_time)),
+		MapTimeToTile(tile_dims));
+	// [[PE->T]->tensor] -> tile
+	isl_union_map *access_to_tile = isl_union_map_apply_range(
+		isl_union_map_domain_map(unique_access), space_time_to_tile);
+	return isl_union_map_card(isl_union_map_reverse(access_to_tile));
 }
 
-Dataflow
-Dataflow::copy() const
-{
+isl_union_pw_qpolynomial *
+Dataflow::GetTileUniqueBits(
+	string tensor_name,
+	AccessType type,
+	isl_union_map *space_time_to_neighbor,
+	unsigned tile_dims)
+{
+	isl_union_pw_qpolynomial *bits = bits_fn(tensor_name, type, [&](string tensor) {
+		return GetTileUniqueVolume(tensor, type,
+			isl_union_map_copy(space_time_to_neighbor), tile_dims);
+	});
+	isl_union_map_free(space_time_to_neighbor);
+	return bits;
+}
+
+/*
+* GetTileTime: the number of time stamps in each tile
+*/
+isl_union_pw_qpolynomial *
+Dataflow::GetTileTime(unsigned tile_dims)
+{
+	return isl_union_map_card(isl_union_map_reverse(MapTimeToTile(tile_dims)));
+}
+
+/*
+* GetPipelineDelay: simulate a double-buffered pipeline over the tiles in time
+* order. Tile i is loaded once its input buffer is released by tile i-2,
+* computed once loaded and its output buffer is drained by tile i-2's store,
+* and stored after it is computed. Loads and stores use separate channels of
+* PEArray bandwidth, every time stamp takes one cycle. When there are too many
+* tiles to enumerate, the trailing tile dims are dropped until there are few
+* enough, so the pipeline runs over coarser tiles.
+*/
+PipelineDelay
+Dataflow::GetPipelineDelay(isl_union_map *space_time_to_neighbor, unsigned tile_dims)
+{
+	while (tile_dims > 0 && tile_num(tile_dims) > MAX_ENUMERATED_POINTS)
+		tile_dims--;
+	isl_union_set *tiles = isl_union_set_apply(GetTimeDomain(), MapTimeToTile(tile_dims));
+	auto points = EvaluateOnPoints(tiles, {
+		GetTileUniqueBits("", AccessType::READ,
+			isl_union_map_copy(space_time_to_neighbor), tile_dims),
+		GetTileUniqueBits("", AccessType::WRITE,
+			space_time_to_neighbor, tile_dims),
+		GetTileTime(tile_dims)
+	});
+
+	PipelineDelay ret;
+	ret.tile_num = points.size();
+	unsigned bandwidth = _pe.GetBandwidth(), avg_latency = _pe.GetAvgLatency();
+	// end time of load/compute/store of the previous two tiles
+	double load_end = 0, compute_end[2] = {0, 0}, store_end[2] = {0, 0};
+	for (auto& point : points)
+	{
+		double load = transfer_delay(point.values[0], bandwidth, avg_latency);
+		double store = transfer_delay(point.values[1], bandwidth, avg_latency);
+		double compute = point.values[2];
+
+		load_end = max(load_end, compute_end[1]) + load;
+		double input_ready = load_end, output_ready = store_end[1];
+		double compute_start = max(compute_end[0], max(input_ready, output_ready));
+		if (input_ready >= output_ready)
+			ret.ingress_stall += compute_start - compute_end[0];
+		else
+			ret.egress_stall += compute_start - compute_end[0];
+		ret.compute += compute;
+
+		compute_end[1] = compute_end[0];
+		compute_end[0] = compute_start + compute;
+		store_end[1] = store_end[0];
+		store_end[0] = max(compute_end[0], store_end[0]) + store;
+	}
+	ret.total = max(compute_end[0], store_end[0]);
+	ret.egress_stall += ret.total - compute_end[0];
+	return ret;
+}
+
+/*
+* GetBandwidthProfile: the unique volume of every tile divided by its time stamps,
+* tiles are enumerated in time order
+*/
+vector<BandwidthSample>
+Dataflow::GetBandwidthProfile(
+	isl_union_map *space_time_to_neighbor,
+	unsigned tile_dims,
+	AccessType type,
+	string tensor_name)
+{
+	isl_union_set *tiles = isl_union_set_apply(GetTimeDomain(), MapTimeToTile(tile_dims));
+	auto points = EvaluateOnPoints(tiles, {
+		GetTileUniqueBits(tensor_name, type, space_time_to_neighbor, tile_dims),
+		GetTileTime(tile_dims)
+	});
+	vector<BandwidthSample> ret;
+	for (auto& point : points)
+	{
+		BandwidthSample sample;
+		sample.tile = point.coords;
+		sample.bits = point.values[0];
+		sample.cycles = point.values[1];
+		ret.push_back(sample);
+	}
+	return ret;
+}
+
+/*
+* GetPeakBandwidth: the highest bandwidth demand over all tiles. When there are too
+* many tiles to enumerate, the max volume over the min tile time is returned,
+* which is an upper bound of the peak.
+*/
+double
+Dataflow::GetPeakBandwidth(
+	isl_union_map *space_time_to_neighbor,
+	unsigned tile_dims,
+	AccessType type,
+	string tensor_name)
+{
+	if (tile_num(tile_dims) <= MAX_ENUMERATED_POINTS)
+	{
+		double peak = 0;
+		for (auto& sample : GetBandwidthProfile(space_time_to_neighbor, tile_dims, type, tensor_name))
+			peak = max(peak, sample.GetBandwidth());
+		return peak;
+	}
+	double max_bits = convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+		GetTileUniqueBits(tensor_name, type, space_time_to_neighbor, tile_dims),
+		isl_fold_max, NULL));
+	double min_time = convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+		GetTileTime(tile_dims), isl_fold_min, NULL));
+	return min_time > 0 ? max_bits / min_time : 0;
+}
+
+/*
+* GetPercentileBandwidth: the bandwidth that covers the demand of percentile
+* (0-100) percent of all cycles. When there are too many tiles to enumerate,
+* the trailing tile dims are dropped until there are few enough, so the
+* demand is averaged over coarser tiles.
+*/
+double
+Dataflow::GetPercentileBandwidth(
+	isl_union_map *space_time_to_neighbor,
+	unsigned tile_dims,
+	AccessType type,
+	double percentile,
+	string tensor_name)
+{
+	while (tile_dims > 0 && tile_num(tile_dims) > MAX_ENUMERATED_POINTS)
+		tile_dims--;
+	auto profile = GetBandwidthProfile(space_time_to_neighbor, tile_dims, type, tensor_name);
+	sort(profile.begin(), profile.end(), [](auto& a, auto& b)
+		{ return a.GetBandwidth() < b.GetBandwidth(); });
+	double total_cycles = 0;
+	for (auto& sample : profile)
+		total_cycles += sample.cycles;
+	double covered = 0;
+	for (auto& sample : profile)
+	{
+		covered += sample.cycles;
+		if (covered >= total_cycles * percentile / 100)
+			return sample.GetBandwidth();
+	}
+	return 0;
+}
+
+void
+Dataflow::StreamAccesses(
+	string tensor_name,
+	AccessType type,
+	unsigned slice_dims,
+	function<bool(const AccessEvent&)> fn)
+{
+	vector<pair<string, AccessType>> streams;
+	auto [input, output] = _st.GetTensorList();
+	for (auto [tensors, t] : {make_pair(input, AccessType::READ), make_pair(output, AccessType::WRITE)})
+		for (auto& tensor : tensors)
+			if ((type == t || type == AccessType::READ_OR_WRITE) &&
+				(tensor_name == "" || tensor_name == tensor))
+				streams.emplace_back(tensor, t);
+	vector<isl_union_map*> accesses;
+	for (auto& [tensor, t] : streams)
+		accesses.push_back(MapSpaceTimeToAccess(tensor, t));
+
+	unsigned pe_dims = set_dim(GetSpaceDomain());
+	unsigned time_dims = set_dim(GetTimeDomain());
+	slice_dims = min(slice_dims, time_dims);
+	isl_union_map *time_to_slice = MapTimeToTile(slice_dims);
+	isl_union_set *slice_domain = isl_union_map_range(isl_union_map_copy(time_to_slice));
+	isl_union_map *space_time = isl_union_set_unwrap(GetSpaceTimeDomain());
+	bool go = true;
+	for (auto& slice : EvaluateOnPoints(isl_union_set_copy(slice_domain), {}))
+	{
+		if (!go)
+			break;
+		isl_set *slice_set = isl_set_from_union_set(isl_union_set_copy(slice_domain));
+		for (unsigned d = 0; d < slice_dims; d++)
+			slice_set = isl_set_fix_si(slice_set, isl_dim_set, d, slice.coords[d]);
+		isl_union_set *times = isl_union_set_apply(isl_union_set_from_set(slice_set),
+			isl_union_map_reverse(isl_union_map_copy(time_to_slice)));
+		isl_union_set *points = isl_union_map_wrap(
+			isl_union_map_intersect_range(isl_union_map_copy(space_time), times));
+
+		vector<AccessEvent> events;
+		for (unsigned s = 0; s < streams.size(); s++)
+		{
+			isl_union_map *slice_access = isl_union_map_intersect_domain(
+				isl_union_map_copy(accesses[s]), isl_union_set_copy(points));
+			for (auto& point : EvaluateOnPoints(isl_union_map_wrap(slice_access), {}))
+			{
+				AccessEvent event;
+				auto begin = point.coords.begin();
+				event.pe.assign(begin, begin + pe_dims);
+				event.time.assign(begin + pe_dims, begin + pe_dims + time_dims);
+				event.element.assign(begin + pe_dims + time_dims, point.coords.end());
+				event.tensor_id = s;
+				event.tensor = &streams[s].first;
+				event.type = streams[s].second;
+				events.push_back(move(event));
+			}
+		}
+		isl_union_set_free(points);
+		sort(events.begin(), events.end(), [](auto& a, auto& b) {
+			return tie(a.time, a.pe, a.tensor_id, a.element) <
+				tie(b.time, b.pe, b.tensor_id, b.element);
+		});
+		for (auto& event : events)
+			if (!fn(event))
+			{
+				go = false;
+				break;
+			}
+	}
+	isl_union_map_free(space_time);
+	isl_union_set_free(slice_domain);
+	isl_union_map_free(time_to_slice);
+	for (auto access : accesses)
+		isl_union_map_free(access);
+}
+
+/*
+* GetL1WorkingSet: an element is kept in a PE from its first to its last use
+* on that PE, the working set is the max number of such elements over all
+* PEs and time stamps. The barvinok bound is an upper bound when not tight.
+*/
+double
+Dataflow::GetL1WorkingSet(string tensor_name, AccessType type)
+{
+	// [PE->tensor] -> T
+	isl_union_map *use = isl_union_map_apply_range(
+		isl_union_map_reverse(isl_union_map_range_product(GetSpaceMap(),
+			GetAccess(tensor_name, type))),
+		GetTimeMap());
+	isl_union_map *live = live_range(use, GetTimeDomain());
+	// [PE->T] -> tensor
+	live = isl_union_map_uncurry(isl_union_map_range_reverse(isl_union_map_curry(live)));
+	return max_live(live);
+}
+
+/*
+* GetL2WorkingSet: same as GetL1WorkingSet with all PEs sharing one buffer
+*/
+double
+Dataflow::GetL2WorkingSet(string tensor_name, AccessType type)
+{
+	isl_union_map *use = isl_union_map_apply_range(
+		isl_union_map_reverse(GetAccess(tensor_name, type)), GetTimeMap());
+	return max_live(isl_union_map_reverse(live_range(use, GetTimeDomain())));
+}
+
+/*
+* GetCapacityAwareUniqueVolume: reuse from neighbors in the same time stamp is
+* forwarded directly, while reuse across time stamps needs data held in L1. When
+* the L1 working set of all tensors exceeds L1 size, that part of the reuse is
+* only kept for the fraction of the working set that fits.
+*/
+double
+Dataflow::GetCapacityAwareUniqueVolume(
+	string tensor_name,
+	AccessType type,
+	isl_union_map *space_time_to_neighbor)
+{
+	double unique_volume = GetUniqueVolume(tensor_name, type, space_time_to_neighbor);
+	double working_set = GetL1WorkingSet("", AccessType::READ_OR_WRITE);
+	if (working_set <= _pe.GetL1Size())
+		return unique_volume;
+	double fit = _pe.GetL1Size() / working_set;
+	double spatial_unique_volume = GetUniqueVolume(tensor_name, type,
+		MapSpaceTimeToNeighbor(1, true, 0, true, false));
+	return unique_volume + (spatial_unique_volume - unique_volume) * (1 - fit);
+}
+
+/*
+* GetCapacityAwareFootprint: L2 supplies the capacity aware unique volume and
+* only the first fetch of every element comes from off chip. When the L2 working
+* set of all tensors exceeds L2 size, the refetches are only served by L2 for the
+* fraction of the working set that fits, the rest comes from off chip again.
+*/
+double
+Dataflow::GetCapacityAwareFootprint(
+	string tensor_name,
+	AccessType type,
+	isl_union_map *space_time_to_neighbor)
+{
+	double unique_volume = GetCapacityAwareUniqueVolume(tensor_name, type, space_time_to_neighbor);
+	double footprint = GetFootprint(tensor_name, type);
+	double working_set = GetL2WorkingSet("", AccessType::READ_OR_WRITE);
+	if (working_set <= _pe.GetL2Size())
+		return footprint;
+	double fit = _pe.GetL2Size() / working_set;
+	return footprint + max(0.0, unique_volume - footprint) * (1 - fit);
+}
+
+/*
+* MapLinkToTransfer: elements a PE can keep from its own earlier time stamps
+* do not use any link, the others are sent over the link from the supplier
+* PE to the consumer PE at the time stamp of the consumer
+*/
+isl_union_map *
+Dataflow::MapLinkToTransfer(
+	string tensor_name,
+	AccessType type,
+	isl_union_map *space_time_to_neighbor)
+{
+	isl_union_map *space_time = isl_union_set_unwrap(GetSpaceTimeDomain());
+	isl_union_map *to_pe = isl_union_map_domain_map(isl_union_map_copy(space_time));
+	isl_union_map *to_time = isl_union_map_range_map(space_time);
+	// [PE->T] -> [PE->T'] with the same PE
+	isl_union_map *same_pe = isl_union_map_product(
+		isl_union_set_identity(GetSpaceDomain()),
+		isl_union_map_from_domain_and_range(GetTimeDomain(), GetTimeDomain()));
+
+	isl_union_map *access = MapSpaceTimeToAccess(tensor_name, type);
+	// [[PE->T]->tensor] -> [PE->T] and -> tensor
+	isl_union_map *to_consumer = isl_union_map_domain_map(isl_union_map_copy(access));
+	isl_union_map *to_element = isl_union_map_range_map(isl_union_map_copy(access));
+	// [[PE->T]->tensor] -> neighbors that access the same element
+	isl_union_map *supplier = isl_union_map_intersect(
+		isl_union_map_apply_range(isl_union_map_copy(to_consumer), space_time_to_neighbor),
+		isl_union_map_apply_range(isl_union_map_copy(to_element), isl_union_map_reverse(access)));
+	isl_union_map *self_supplier = isl_union_map_intersect(isl_union_map_copy(supplier),
+		isl_union_map_apply_range(isl_union_map_copy(to_consumer), same_pe));
+	supplier = isl_union_map_subtract_domain(supplier, isl_union_map_domain(self_supplier));
+	supplier = isl_union_map_lexmin(supplier);
+
+	isl_union_map *link = isl_union_map_range_product(
+		isl_union_map_apply_range(supplier, isl_union_map_copy(to_pe)),
+		isl_union_map_apply_range(isl_union_map_copy(to_consumer), to_pe));
+	isl_union_map *transfer = isl_union_map_range_product(
+		isl_union_map_apply_range(to_consumer, to_time), to_element);
+	return isl_union_map_apply_range(isl_union_map_reverse(link), transfer);
+}
+
+vector<LinkLoad>
+Dataflow::GetLinkLoad(
+	string tensor_name,
+	AccessType type,
+	isl_union_map *space_time_to_neighbor)
+{
+	isl_union_map *link_to_transfer =
+		MapLinkToTransfer(tensor_name, type, space_time_to_neighbor);
+	// [link->T] -> tensor
+	isl_union_map *load = isl_union_map_uncurry(isl_union_map_copy(link_to_transfer));
+	isl_union_pw_qpolynomial *load_num = isl_union_map_card(load);
+	auto links = EvaluateOnPoints(isl_union_map_domain(isl_union_map_copy(link_to_transfer)),
+		{isl_union_map_card(link_to_transfer)});
+
+	vector<LinkLoad> ret;
+	map<vector<long>, unsigned> link_idx;
+	for (auto& point : links)
+	{
+		unsigned n = point.coords.size() / 2;
+		LinkLoad link;
+		link.src.assign(point.coords.begin(), point.coords.begin() + n);
+		link.dst.assign(point.coords.begin() + n, point.coords.end());
+		link.volume = point.values[0];
+		link_idx[point.coords] = ret.size();
+		ret.push_back(move(link));
+	}
+	if (ret.empty())
+	{
+		isl_union_pw_qpolynomial_free(load_num);
+		return ret;
+	}
+
+	isl_union_set *link_time = isl_union_pw_qpolynomial_domain(
+		isl_union_pw_qpolynomial_copy(load_num));
+	if (convert_upwqp_to_int(isl_union_set_card(isl_union_set_copy(link_time))) >
+		MAX_ENUMERATED_POINTS)
+	{
+		// too many points, use the bound over all links
+		isl_union_set_free(link_time);
+		double peak = convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+			load_num, isl_fold_max, NULL));
+		for (auto& link : ret)
+			link.peak = peak;
+		return ret;
+	}
+	unsigned link_dims = 2 * ret[0].src.size();
+	for (auto& point : EvaluateOnPoints(link_time, {load_num}))
+	{
+		vector<long> coords(point.coords.begin(), point.coords.begin() + link_dims);
+		LinkLoad &link = ret[link_idx[coords]];
+		link.peak = max(link.peak, point.values[0]);
+	}
+	return ret;
+}
+
+double
+Dataflow::GetContentionDelay(
+	string tensor_name,
+	AccessType type,
+	isl_union_map *space_time_to_neighbor,
+	unsigned link_bandwidth)
+{
+	double total_time = GetTotalTime();
+	// [link->T] -> bits sent
+	isl_union_pw_qpolynomial *load_num = bits_fn(tensor_name, type, [&](string tensor) {
+		return isl_union_map_card(isl_union_map_uncurry(
+			MapLinkToTransfer(tensor, type, isl_union_map_copy(space_time_to_neighbor))));
+	});
+	isl_union_map_free(space_time_to_neighbor);
+	isl_union_set *link_time = isl_union_pw_qpolynomial_domain(
+		isl_union_pw_qpolynomial_copy(load_num));
+	double point_num = convert_upwqp_to_int(isl_union_set_card(isl_union_set_copy(link_time)));
+	if (point_num > MAX_ENUMERATED_POINTS)
+	{
+		// too many points, assume every time stamp sees the peak load
+		isl_union_set_free(link_time);
+		double peak = convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+			load_num, isl_fold_max, NULL));
+		return total_time * max(1.0, ceil(peak / link_bandwidth));
+	}
+	// time stamp -> load of its busiest link
+	unsigned link_dims = 2 * set_dim(GetSpaceDomain());
+	map<vector<long>, double> busiest;
+	for (auto& point : EvaluateOnPoints(link_time, {load_num}))
+	{
+		vector<long> time(point.coords.begin() + link_dims, point.coords.end());
+		busiest[time] = max(busiest[time], point.values[0]);
+	}
+	double delay = total_time;
+	for (auto& [time, load] : busiest)
+		delay += max(1.0, ceil(load / link_bandwidth)) - 1;
+	return delay;
+}
+
+isl_union_map *
+Dataflow::MapSpaceTimeToLevelNeighbor(unsigned level)
+{
+	auto& levels = _pe.GetLevels();
+	isl_union_map *space_to_neighbor = isl_union_set_identity(GetSpaceDomain());
+	for (unsigned i = 0; i <= level && i < levels.size(); i++)
+		space_to_neighbor = isl_union_map_union(space_to_neighbor,
+			isl_union_map_copy(levels[i].interconnect.get()));
+	space_to_neighbor = isl_union_map_intersect_range(space_to_neighbor, GetSpaceDomain());
+	isl_union_map *space_time_to_neighbor = isl_union_map_product(space_to_neighbor,
+		MapTimeToPrev(1, true));
+	return isl_union_map_subtract(space_time_to_neighbor,
+		isl_union_set_identity(GetSpaceTimeDomain()));
+}
+
+/*
+* GetLevelTraffic: an access reused over level l is unique when only the
+* networks of the levels below l are used, and not unique when level l is
+* added. It is forwarded by the network of the cluster of the receiving PE.
+* When the cluster footprint exceeds the buffer of the level (0 for no limit),
+* only the fraction of the forwarded reuse that fits is kept, and the rest is
+* moved from above the outermost level like the unique volume.
+*/
+vector<LevelTraffic>
+Dataflow::GetLevelTraffic(string tensor_name, AccessType type)
+{
+	auto& levels = _pe.GetLevels();
+	vector<LevelTraffic> ret(levels.size());
+	vector<isl_union_pw_qpolynomial*> cluster_bits(levels.size(), NULL);
+	vector<isl_union_pw_qpolynomial*> cluster_footprint(levels.size(), NULL);
+	vector<double> reuse_bits(levels.size(), 0);
+	auto add = [](isl_union_pw_qpolynomial *&sum, isl_union_pw_qpolynomial *v)
+		{ sum = sum == NULL ? v : isl_union_pw_qpolynomial_add(sum, v); };
+
+	for (auto& tensor : select_tensors(tensor_name, type))
+	{
+		double bits = GetBitsPerItem(tensor, type);
+		isl_union_map *unique = MapSpaceTimeToUniqueAccess(tensor, type,
+			MapSpaceTimeToNeighbor(0, true, 1, true, false));
+		for (unsigned l = 0; l < levels.size(); l++)
+		{
+			isl_union_map *level_unique =
+				MapSpaceTimeToUniqueAccess(tensor, type, MapSpaceTimeToLevelNeighbor(l));
+			isl_union_map *forwarded = isl_union_map_subtract(unique,
+				isl_union_map_copy(level_unique));
+			double reuse_volume = access_num(isl_union_map_copy(forwarded));
+			double unique_volume = access_num(isl_union_map_copy(level_unique));
+			ret[l].reuse_volume += reuse_volume;
+			ret[l].unique_volume += unique_volume;
+			ret[l].unique_bits += unique_volume * bits;
+			reuse_bits[l] += reuse_volume * bits;
+			unique = level_unique;
+
+			// [PE->T] -> [cluster->T]
+			isl_union_map *to_cluster = isl_union_map_product(
+				isl_union_map_copy(levels[l].cluster.get()),
+				isl_union_set_identity(GetTimeDomain()));
+			isl_union_pw_qpolynomial *num = isl_union_map_card(
+				isl_union_map_apply_domain(forwarded, to_cluster));
+			add(cluster_bits[l], scale(isl_union_pw_qpolynomial_sum(num), bits)); // sum on time
+			// cluster -> elements of the tensor
+			isl_union_map *cluster_access = isl_union_map_apply_domain(
+				isl_union_map_domain_factor_domain(MapSpaceTimeToAccess(tensor, type)),
+				isl_union_map_copy(levels[l].cluster.get()));
+			add(cluster_footprint[l], isl_union_map_card(cluster_access));
+		}
+		isl_union_map_free(unique);
+	}
+
+	// reuse lost in the buffers of the levels below
+	double lost_volume = 0, lost_bits = 0;
+	for (unsigned l = 0; l < levels.size(); l++)
+	{
+		ret[l].name = levels[l].name;
+		if (cluster_bits[l] == NULL)
+			continue;
+		ret[l].cluster_bits = convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+			cluster_bits[l], isl_fold_max, NULL));
+		ret[l].cluster_footprint = convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+			cluster_footprint[l], isl_fold_max, NULL));
+		if (levels[l].buffer > 0 && ret[l].cluster_footprint > levels[l].buffer)
+		{
+			double fit = levels[l].buffer / ret[l].cluster_footprint;
+			lost_volume += ret[l].reuse_volume * (1 - fit);
+			lost_bits += reuse_bits[l] * (1 - fit);
+			ret[l].reuse_volume *= fit;
+			ret[l].cluster_bits *= fit;
+		}
+		ret[l].unique_volume += lost_volume;
+		ret[l].unique_bits += lost_bits;
+		ret[l].delay = transfer_delay(ret[l].cluster_bits, levels[l].bandwidth,
+			levels[l].avg_latency);
+	}
+	return ret;
+}
+
+double
+Dataflow::GetHierarchicalDelay()
+{
+	auto& levels = _pe.GetLevels();
+	if (levels.empty())
+		return GetDelay(MapSpaceTimeToNeighbor());
+	double delay = GetComputationDelay();
+	// ingress and egress above the outermost level share the array bandwidth
+	double top_bits = 0;
+	for (AccessType type : {AccessType::READ, AccessType::WRITE})
+	{
+		vector<LevelTraffic> traffic = GetLevelTraffic("", type);
+		for (auto& level : traffic)
+			delay = max(delay, level.delay);
+		top_bits += traffic.back().unique_bits;
+	}
+	return max(delay, transfer_delay(top_bits, _pe.GetBandwidth(), _pe.GetAvgLatency()));
+}
+
+isl_union_map *
+Dataflow::GetDeviceMap()
+{
+	isl_union_map *device_map = _mp.HasDeviceMap() ? _mp.GetDeviceMap() :
+		isl_union_map_from_domain(GetDomain()); // a single anonymous device
+	return isl_union_map_intersect_domain(device_map, GetDomain());
+}
+
+vector<Dataflow>
+Dataflow::GetDeviceDataflows()
+{
+	vector<Dataflow> ret;
+	isl_union_map *device_map = GetDeviceMap();
+	for (auto device : collect_points(isl_union_map_range(isl_union_map_copy(device_map))))
+	{
+		Statement st = _st.copy();
+		st.IntersectDomain(isl_union_set_apply(device,
+			isl_union_map_reverse(isl_union_map_copy(device_map))));
+		Mapping mp = _mp.copy();
+		mp.ClearDeviceMap();
+		ret.emplace_back(move(st), _pe.copy(), move(mp));
+	}
+	isl_union_map_free(device_map);
+	return ret;
+}
+
+DeviceSplit
+Dataflow::GetDeviceSplit(int mac_per_instance)
+{
+	DeviceSplit ret;
+	// device -> instances
+	isl_union_pw_qpolynomial *mac = isl_union_map_card(isl_union_map_reverse(GetDeviceMap()));
+	ret.device_num = convert_upwqp_to_int(isl_union_set_card(
+		isl_union_pw_qpolynomial_domain(isl_union_pw_qpolynomial_copy(mac))));
+	ret.max_mac = mac_per_instance * convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+		mac, isl_fold_max, NULL));
+	if (ret.device_num > 0)
+		ret.average_mac = GetMacNum(mac_per_instance) / ret.device_num;
+	if (ret.max_mac > 0)
+		ret.balance = ret.average_mac / ret.max_mac;
+	return ret;
+}
+
+/*
+* GetDeviceTraffic: with E_d the elements device d needs, the devices hold
+* sum |E_d| copies of |union E_d| elements. Device d receives (or sends) the
+* elements of E_d that an earlier device already needs.
+*/
+DeviceTraffic
+Dataflow::GetDeviceTraffic(
+	string tensor_name,
+	AccessType type,
+	unsigned link_bandwidth,
+	unsigned link_latency)
+{
+	DeviceTraffic ret;
+	isl_union_map *device_map = GetDeviceMap();
+	vector<isl_union_set*> devices = collect_points(isl_union_map_range(
+		isl_union_map_copy(device_map)));
+	vector<double> device_bits(devices.size(), 0);
+	for (auto& tensor : select_tensors(tensor_name, type))
+	{
+		// device -> elements
+		isl_union_map *device_to_tensor = isl_union_map_apply_range(
+			isl_union_map_reverse(isl_union_map_copy(device_map)), GetAccess(tensor, type));
+		isl_union_set *held = NULL, *shared = NULL;
+		double copies = 0;
+		for (unsigned d = 0; d < devices.size(); d++)
+		{
+			isl_union_set *elements = isl_union_set_apply(isl_union_set_copy(devices[d]),
+				isl_union_map_copy(device_to_tensor));
+			double volume = convert_upwqp_to_int(isl_union_set_card(isl_union_set_copy(elements)));
+			copies += volume;
+			ret.max_device_volume = max(ret.max_device_volume, volume);
+			if (held == NULL)
+			{
+				held = isl_union_set_copy(elements);
+				shared = elements;
+				continue;
+			}
+			double moved = convert_upwqp_to_int(isl_union_set_card(isl_union_set_intersect(
+				isl_union_set_copy(elements), isl_union_set_copy(held))));
+			device_bits[d] += moved * GetBitsPerItem(tensor, type);
+			held = isl_union_set_union(held, isl_union_set_copy(elements));
+			shared = isl_union_set_intersect(shared, elements);
+		}
+		isl_union_map_free(device_to_tensor);
+		if (held == NULL)
+			continue;
+		double footprint = convert_upwqp_to_int(isl_union_set_card(held));
+		double replicated = (devices.size() - 1) *
+			convert_upwqp_to_int(isl_union_set_card(shared));
+		ret.footprint += footprint;
+		ret.replicated_volume += replicated;
+		ret.halo_volume += copies - footprint - replicated;
+		ret.inter_device_volume += copies - footprint;
+	}
+	for (auto device : devices)
+		isl_union_set_free(device);
+	isl_union_map_free(device_map);
+	for (double bits : device_bits)
+		ret.delay = max(ret.delay, transfer_delay(bits, link_bandwidth, link_latency));
+	return ret;
+}
+
+/*
+* GetTemporalReuseHistogram: histogram[d] is the number of accesses whose
+* element the same PE last accessed d time stamps before (histogram[0] is 0).
+* The neighbor at distance d is built from the one at d-1, and only the
+* accesses not yet reused are checked at the next distance.
+*/
+vector<double>
+Dataflow::GetTemporalReuseHistogram(string tensor_name, AccessType type, unsigned max_distance)
+{
+	vector<double> histogram(max_distance + 1, 0);
+	isl_union_map *access = MapSpaceTimeToAccess(tensor_name, type);
+	// not restricted to the space-time domain, so that the chain of steps
+	// passes the time stamps where the PE is idle
+	isl_union_map *step = isl_union_map_product(
+		isl_union_set_identity(GetSpaceDomain()), MapTimeToPrev(1, false));
+	isl_union_map *neighbor = isl_union_map_copy(step);
+	isl_union_map *remain = isl_union_map_copy(access);
+	double remain_num = access_num(isl_union_map_copy(remain));
+	for (unsigned d = 1; d <= max_distance && remain_num > 0; d++)
+	{
+		if (d > 1)
+			neighbor = isl_union_map_apply_range(neighbor, isl_union_map_copy(step));
+		remain = isl_union_map_subtract(remain, isl_union_map_apply_range(
+			isl_union_map_copy(neighbor), isl_union_map_copy(access)));
+		double num = access_num(isl_union_map_copy(remain));
+		histogram[d] = remain_num - num;
+		remain_num = num;
+	}
+	isl_union_map_free(step);
+	isl_union_map_free(neighbor);
+	isl_union_map_free(remain);
+	isl_union_map_free(access);
+	return histogram;
+}
+
+/*
+* GetSpatialReuseHistogram: histogram[h] is the number of accesses whose
+* element is found at most time_distance time stamps before (same time stamp
+* included) on a PE h hops away, and not on any closer PE. histogram[0] is the
+* reuse from the PE itself. Like the temporal histogram, hop h builds on h-1.
+*/
+vector<double>
+Dataflow::GetSpatialReuseHistogram(
+	string tensor_name,
+	AccessType type,
+	unsigned max_hops,
+	unsigned time_distance)
+{
+	vector<double> histogram(max_hops + 1, 0);
+	isl_union_map *access = MapSpaceTimeToAccess(tensor_name, type);
+	isl_union_map *time_window = MapTimeToPrev(time_distance, true);
+	isl_union_map *hop = _pe.GetInterconnect();
+	hop = isl_union_map_union(hop, isl_union_set_identity(_pe.GetDomain()));
+	// PEs within h hops, and exactly h hops
+	isl_union_map *within = isl_union_set_identity(GetSpaceDomain());
+	isl_union_map *ring = isl_union_map_copy(within);
+	isl_union_map *remain = isl_union_map_copy(access);
+	double remain_num = access_num(isl_union_map_copy(remain));
+	for (unsigned h = 0; h <= max_hops && remain_num > 0; h++)
+	{
+		if (h > 0)
+		{
+			isl_union_map *next = isl_union_map_apply_range(
+				isl_union_map_copy(within), isl_union_map_copy(hop));
+			isl_union_map_free(ring);
+			ring = isl_union_map_subtract(isl_union_map_copy(next), within);
+			within = next;
+		}
+		isl_union_map *neighbor = isl_union_map_product(
+			isl_union_map_copy(ring), isl_union_map_copy(time_window));
+		if (h == 0)
+			neighbor = isl_union_map_subtract(neighbor,
+				isl_union_set_identity(GetSpaceTimeDomain()));
+		remain = isl_union_map_subtract(remain, isl_union_map_apply_range(
+			neighbor, isl_union_map_copy(access)));
+		double num = access_num(isl_union_map_copy(remain));
+		histogram[h] = remain_num - num;
+		remain_num = num;
+	}
+	isl_union_map_free(time_window);
+	isl_union_map_free(hop);
+	isl_union_map_free(within);
+	isl_union_map_free(ring);
+	isl_union_map_free(remain);
+	isl_union_map_free(access);
+	return histogram;
+}
+
+double
+Dataflow::GetL1Read(string tensor_name, AccessType type)
+{
+	if (type == AccessType::READ || type == AccessType::WRITE)
+		return GetTotalVolume(tensor_name, type);
+	else
+		// for tensor that both be input and output, one L1 read for L1->PE and one for L1->L2
+		return GetTotalVolume(tensor_name, AccessType::READ) + GetTotalVolume(tensor_name, AccessType::WRITE);
+}
+
+double
+Dataflow::GetL1Write(string tensor_name, AccessType type)
+{
+	if (type == AccessType::READ || type == AccessType::WRITE)
+		return GetTotalVolume(tensor_name, type);
+	else
+		// for tensor that both be input and output, one L1 write for L2->L1 and one for PE->L1
+		return GetTotalVolume(tensor_name, AccessType::READ) + GetTotalVolume(tensor_name, AccessType::WRITE);
+}
+
+double
+Dataflow::GetL2Read(
+	string tensor_name,
+	AccessType type,
+	isl_union_map* space_time_to_neighbor)
+{
+	if (type == AccessType::READ || type == AccessType::WRITE)
+		// reuse can be exploited  to reduce L2 read
+		return GetUniqueVolume(tensor_name, type, space_time_to_neighbor);
+	else
+		// for tensor that both be input and output, one L2 read for L2->L1 and one for L2->DRAM
+		return GetUniqueVolume( tensor_name, AccessType::READ,
+					isl_union_map_copy(space_time_to_neighbor)
+				) + GetUniqueVolume(tensor_name, AccessType::WRITE, space_time_to_neighbor);
+}
+
+double
+Dataflow::GetL2Write(
+	string tensor_name,
+	AccessType type,
+	isl_union_map* space_time_to_neighbor)
+{
+	if (type == AccessType::READ || type == AccessType::WRITE)
+		// reuse can be exploited to reduce L2 write
+		return GetUniqueVolume(tensor_name, type, space_time_to_neighbor);
+	else
+		// for tensor that both be input and output, one L2 write for DRAM->L2 and one for L1->L2
+		return GetUniqueVolume(tensor_name, AccessType::READ, isl_union_map_copy(space_time_to_neighbor)) +
+		GetUniqueVolume(tensor_name, AccessType::WRITE, space_time_to_neighbor);
+}
+
+vector<function<double(Dataflow&, isl_union_map*)>>
+Dataflow::energy_terms(string tensor_name, AccessType type)
+{
+	// access costs are per BIT_PER_ITEM bits
+	auto width = [=](Dataflow& df) { return df.GetBitsPerItem(tensor_name, type) / BIT_PER_ITEM; };
+	vector<function<double(Dataflow&, isl_union_map*)>> terms{
+		[=](Dataflow& df, isl_union_map*) {
+			return width(df) * l1_multiplier * df.GetL1Read(tensor_name, type);
+		},
+		[=](Dataflow& df, isl_union_map*) {
+			return width(df) * l1_multiplier * df.GetL1Write(tensor_name, type);
+		},
+		[=](Dataflow& df, isl_union_map* space_time_to_neighbor) {
+			return width(df) * l2_multiplier * df.GetL2Read(tensor_name, type,
+				isl_union_map_copy(space_time_to_neighbor));
+		},
+		[=](Dataflow& df, isl_union_map* space_time_to_neighbor) {
+			return width(df) * l2_multiplier * df.GetL2Write(tensor_name, type,
+				isl_union_map_copy(space_time_to_neighbor));
+		}
+	};
+	if (type == AccessType::READ)
+		terms.push_back([=](Dataflow& df, isl_union_map* space_time_to_neighbor) {
+			return width(df) * fanout_multiplier * df.GetMulticastFanout(tensor_name,
+				isl_union_map_copy(space_time_to_neighbor));
+		});
+	return terms;
+}
+
+double
+Dataflow::GetEnergy(isl_union_map* space_time_to_neighbor)
+{
+	double energy = GetMacNum();  // energy cost of MAC
+	auto [input, output] = _st.GetTensorList();
+	for (auto [tensors, type] : {make_pair(input, AccessType::READ), make_pair(output, AccessType::WRITE)})
+		for (auto& tensor : tensors)
+			for (auto& term : energy_terms(tensor, type))
+				energy += term(*this, space_time_to_neighbor);
+	isl_union_map_free(space_time_to_neighbor);
+	return energy;
+}
+
+/*
+* dram_traffic: every tile loads the elements it accesses (its footprint), except
+* those already accessed by the previous tile that are still in L2. L2 holds the
+* footprint of all tensors of the previous tile, and keeps the fraction of it
+* that fits in L2 size. Writes use the same formula: a tile writes back its
+* footprint, except the elements the previous tile also wrote that are still in
+* L2, which count once for the run of tiles updating them.
+*/
+double
+Dataflow::dram_traffic(string tensor_name, AccessType type, unsigned tile_dims)
+{
+	isl_union_map *tile_map = MapTimeToTile(tile_dims);
+	isl_union_set *tiles = isl_union_set_apply(GetTimeDomain(), isl_union_map_copy(tile_map));
+	// tile -> instance
+	isl_union_map *tile_to_domain = isl_union_map_reverse(
+		isl_union_map_apply_range(GetTimeMap(), tile_map));
+	// tile -> element
+	isl_union_map *footprint = isl_union_map_apply_range(
+		isl_union_map_copy(tile_to_domain), GetAccess(tensor_name, type));
+	isl_union_map *footprint_all = isl_union_map_apply_range(
+		tile_to_domain, GetAccess("", AccessType::READ_OR_WRITE));
+	isl_union_map *overlap = isl_union_map_intersect(isl_union_map_copy(footprint),
+		isl_union_map_apply_range(map_to_prev(isl_union_set_copy(tiles)),
+			isl_union_map_copy(footprint)));
+
+	isl_union_pw_qpolynomial *footprint_num = isl_union_map_card(footprint);
+	isl_union_pw_qpolynomial *overlap_num = isl_union_map_card(overlap);
+	isl_union_pw_qpolynomial *footprint_all_num = isl_union_map_card(footprint_all);
+	double l2size = _pe.GetL2Size();
+
+	double tile_num = convert_upwqp_to_int(isl_union_set_card(isl_union_set_copy(tiles)));
+	if (tile_num > MAX_ENUMERATED_POINTS)
+	{
+		// too many tiles, assume the largest tile footprint everywhere
+		isl_union_set_free(tiles);
+		double max_footprint = convert_upwqpf_to_int(isl_union_pw_qpolynomial_bound(
+			footprint_all_num, isl_fold_max, NULL));
+		double resident = max_footprint > 0 ? min(1.0, l2size / max_footprint) : 1.0;
+		return convert_upwqp_to_int(isl_union_pw_qpolynomial_sum(footprint_num)) -
+			resident * convert_upwqp_to_int(isl_union_pw_qpolynomial_sum(overlap_num));
+	}
+
+	auto points = EvaluateOnPoints(tiles, {footprint_num, overlap_num, footprint_all_num});
+	double traffic = 0, prev_footprint_all = 0;
+	for (auto& point : points)
+	{
+		double resident = prev_footprint_all > 0 ? min(1.0, l2size / prev_footprint_all) : 1.0;
+		traffic += point.values[0] - resident * point.values[1];
+		prev_footprint_all = point.values[2];
+	}
+	return traffic;
+}
+
+double
+Dataflow::GetDRAMRead(string tensor_name, unsigned tile_dims)
+{
+	return dram_traffic(tensor_name, AccessType::READ, tile_dims);
+}
+
+double
+Dataflow::GetDRAMWrite(string tensor_name, unsigned tile_dims)
+{
+	return dram_traffic(tensor_name, AccessType::WRITE, tile_dims);
+}
+
+double
+Dataflow::GetDRAMDelay(unsigned tile_dims, unsigned dram_bandwidth)
+{
+	double bits = bits_sum("", AccessType::READ,
+			[&](string tensor) { return GetDRAMRead(tensor, tile_dims); }) +
+		bits_sum("", AccessType::WRITE,
+			[&](string tensor) { return GetDRAMWrite(tensor, tile_dims); });
+	return bits / dram_bandwidth;
+}
+
+Dataflow
+Dataflow::copy() const
+{
 	return Dataflow(_st.copy(), _pe.copy(), _mp.copy());
 }
+
+vector<double>
+Dataflow::RunParallel(const vector<function<double(Dataflow&)>>& jobs, unsigned num_threads)
+{
+	num_threads = GetThreadNum(num_threads, jobs.size());
+	vector<double> results(jobs.size(), 0);
+	DataflowText text;
+	if (num_threads > 1)
+		text = Serialize();
+	// the contexts outlive the dataflows built in them
+	vector<shared_ptr<ISL_Context>> contexts(num_threads);
+	vector<unique_ptr<Dataflow>> dataflows(num_threads);
+	vector<char> done(jobs.size(), 0);
+	ParallelFor(jobs.size(), num_threads, [&](unsigned worker, unsigned job)
+	{
+		if (worker == 0)
+		{
+			results[job] = jobs[job](*this);
+			done[job] = 1;
+			return;
+		}
+		if (!contexts[worker])
+		{
+			contexts[worker] = make_shared<ISL_Context>(stdout);
+			dataflows[worker] = Deserialize(contexts[worker], text);
+		}
+		if (dataflows[worker])
+		{
+			results[job] = jobs[job](*dataflows[worker]);
+			done[job] = 1;
+		}
+	});
+	// jobs of a worker whose copy failed to load run here
+	for (unsigned job = 0; job < jobs.size(); job++)
+		if (!done[job])
+			results[job] = jobs[job](*this);
+	return results;
+}
+
+double
+Dataflow::GetParallelDelay(unsigned num_threads)
+{
+	auto [input, output] = _st.GetTensorList();
+	vector<function<double(Dataflow&)>> jobs;
+	jobs.push_back([](Dataflow& df) { return df.GetComputationDelay(); });
+	auto add_jobs = [&](const vector<string>& tensors, AccessType type)
+	{
+		for (auto& tensor : tensors)
+			jobs.push_back([tensor, type](Dataflow& df) {
+				return df.unique_bits(tensor, type, df.MapSpaceTimeToNeighbor());
+			});
+	};
+	add_jobs(input, AccessType::READ);
+	add_jobs(output, AccessType::WRITE);
+	vector<double> results = RunParallel(jobs, num_threads);
+
+	double ingress_bits = 0, egress_bits = 0;
+	for (unsigned i = 0; i < input.size(); i++)
+		ingress_bits += results[1 + i];
+	for (unsigned i = 0; i < output.size(); i++)
+		egress_bits += results[1 + input.size() + i];
+	return combine_delay(ingress_bits, egress_bits, results[0]);
+}
+
+double
+Dataflow::GetParallelEnergy(unsigned num_threads)
+{
+	auto [input, output] = _st.GetTensorList();
+	vector<function<double(Dataflow&)>> jobs;
+	jobs.push_back([](Dataflow& df) { return df.GetMacNum(); });
+	for (auto [tensors, type] : {make_pair(input, AccessType::READ), make_pair(output, AccessType::WRITE)})
+		for (auto& tensor : tensors)
+			for (auto& term : energy_terms(tensor, type))
+				jobs.push_back([term](Dataflow& df) {
+					isl_union_map *space_time_to_neighbor = df.MapSpaceTimeToNeighbor();
+					double energy = term(df, space_time_to_neighbor);
+					isl_union_map_free(space_time_to_neighbor);
+					return energy;
+				});
+	vector<double> results = RunParallel(jobs, num_threads);
+	double energy = 0;
+	for (double result : results)
+		energy += result;
+	return energy;
+}
+
+namespace
+{
+
+struct BoundArgs
+{
+	long lo;
+	long hi;
+	isl_union_set *result;
+};
+
+isl_stat bound_outer(isl_set *set, void *user)
+{
+	auto args = static_cast<BoundArgs*>(user);
+	if (isl_set_dim(set, isl_dim_set) > 0)
+	{
+		set = isl_set_lower_bound_si(set, isl_dim_set, 0, args->lo);
+		set = isl_set_upper_bound_si(set, isl_dim_set, 0, args->hi);
+	}
+	args->result = isl_union_set_add_set(args->result, set);
+	return isl_stat_ok;
+}
+
+// time stamps of df whose outermost dimension is in [lo, hi]
+isl_union_set *time_slab(Dataflow& df, long lo, long hi)
+{
+	isl_union_set *time_domain = df.GetTimeDomain();
+	BoundArgs args{lo, hi, isl_union_set_empty(isl_union_set_get_space(time_domain))};
+	isl_union_set_foreach_set(time_domain, bound_outer, &args);
+	isl_union_set_free(time_domain);
+	return args.result;
+}
+
+// df restricted to the instances run at the given time stamps, times is freed
+Dataflow restrict_to(Dataflow& df, isl_union_set *times)
+{
+	return df.Restrict(isl_union_set_apply(times, isl_union_map_reverse(df.GetTimeMap())));
+}
+
+double unique_at(Dataflow& df, isl_union_set *times, const string& tensor_name, AccessType type)
+{
+	Dataflow sub = restrict_to(df, times);
+	return sub.GetUniqueVolume(tensor_name, type, sub.MapSpaceTimeToNeighbor());
+}
+
+/*
+* boundary_correction: the chunk [lo, hi] counts its first time stamp as if
+* nothing came before it. With the last stamp of the previous chunks, the
+* exact count of the first stamp is the unique volume of the slab of both
+* stamps minus that of the last stamp alone.
+*/
+double boundary_correction(Dataflow& df, long time_lo, long lo, long hi,
+	const string& tensor_name, AccessType type)
+{
+	isl_union_set *first = isl_union_set_lexmin(time_slab(df, lo, hi));
+	isl_union_set *last = isl_union_set_lexmax(time_slab(df, time_lo, lo - 1));
+	if (isl_union_set_is_empty(first) || isl_union_set_is_empty(last))
+	{
+		isl_union_set_free(first);
+		isl_union_set_free(last);
+		return 0;
+	}
+	double slab = unique_at(df,
+		isl_union_set_union(isl_union_set_copy(first), isl_union_set_copy(last)), tensor_name, type);
+	return slab - unique_at(df, last, tensor_name, type) - unique_at(df, first, tensor_name, type);
+}
+
+} // namespace
+
+ChunkedVolume
+Dataflow::GetChunkedVolume(string tensor_name, AccessType type, unsigned chunk_num, unsigned num_threads)
+{
+	ChunkedVolume ret;
+	isl_union_set *time_domain = GetTimeDomain();
+	vector<PointValue> first, last;
+	if (set_dim(isl_union_set_copy(time_domain)) > 0)
+	{
+		first = EvaluateOnPoints(isl_union_set_lexmin(isl_union_set_copy(time_domain)), {});
+		last = EvaluateOnPoints(isl_union_set_lexmax(isl_union_set_copy(time_domain)), {});
+	}
+	isl_union_set_free(time_domain);
+	if (first.empty() || last.empty())
+	{
+		ret.total = GetTotalVolume(tensor_name, type);
+		ret.unique = GetUniqueVolume(tensor_name, type, MapSpaceTimeToNeighbor());
+		ret.chunk_num = 1;
+		return ret;
+	}
+	long lo = first[0].coords[0], hi = last[0].coords[0];
+	for (auto& point : first)
+		lo = min(lo, point.coords[0]);
+	for (auto& point : last)
+		hi = max(hi, point.coords[0]);
+	ret.chunk_num = (unsigned)max(1l, min((long)chunk_num, hi - lo + 1));
+
+	vector<pair<long, long>> chunks;
+	for (long c = 0; c < ret.chunk_num; c++)
+		chunks.emplace_back(lo + (hi - lo + 1) * c / ret.chunk_num,
+			lo + (hi - lo + 1) * (c + 1) / ret.chunk_num - 1);
+	// unique volumes of the chunks, their total volumes, then the corrections
+	// of every chunk boundary
+	vector<function<double(Dataflow&)>> jobs;
+	for (auto& chunk : chunks)
+	{
+		long a = chunk.first, b = chunk.second;
+		jobs.push_back([=](Dataflow& df) {
+			return unique_at(df, time_slab(df, a, b), tensor_name, type);
+		});
+	}
+	for (auto& chunk : chunks)
+	{
+		long a = chunk.first, b = chunk.second;
+		jobs.push_back([=](Dataflow& df) {
+			return restrict_to(df, time_slab(df, a, b)).GetTotalVolume(tensor_name, type);
+		});
+	}
+	for (unsigned c = 1; c < chunks.size(); c++)
+	{
+		long a = chunks[c].first, b = chunks[c].second;
+		jobs.push_back([=](Dataflow& df) {
+			return boundary_correction(df, lo, a, b, tensor_name, type);
+		});
+	}
+	vector<double> results = RunParallel(jobs, num_threads);
+	for (unsigned i = 0; i < chunks.size(); i++)
+	{
+		ret.unique += results[i];
+		ret.total += results[chunks.size() + i];
+	}
+	for (unsigned i = 2 * chunks.size(); i < results.size(); i++)
+		ret.unique += results[i];
+	return ret;
+}
@@ -0,0 +1,190 @@
+#include "fusion.h"
+
+using namespace std;
+using namespace TENET;
+
+namespace
+{
+
+struct RenameArgs
+{
+	const char* name;
+	isl_union_map *result;
+};
+
+isl_stat rename_range_tuple(isl_map *map, void *user)
+{
+	auto args = static_cast<RenameArgs*>(user);
+	map = isl_map_set_tuple_name(map, isl_dim_out, args->name);
+	args->result = isl_union_map_add_map(args->result, map);
+	return isl_stat_ok;
+}
+
+// rename the range tuple of every map, so that the accesses of two
+// statements to the same tensor under different names can be intersected
+isl_union_map *rename_range(isl_union_map *umap, const char* name)
+{
+	RenameArgs args{name, isl_union_map_empty(isl_union_map_get_space(umap))};
+	isl_union_map_foreach_map(umap, rename_range_tuple, &args);
+	isl_union_map_free(umap);
+	return args.result;
+}
+
+double card(isl_union_set *uset)
+{
+	return convert_upwqp_to_int(isl_union_set_card(uset));
+}
+
+} // namespace
+
+FusedPair::FusedPair(
+	Dataflow &producer,
+	string producer_tensor,
+	Dataflow &consumer,
+	string consumer_tensor):
+	_producer(producer),
+	_consumer(consumer),
+	_producer_tensor(producer_tensor),
+	_consumer_tensor(consumer_tensor)
+{}
+
+void
+FusedPair::analyze()
+{
+	if (_analyzed)
+		return;
+	isl_union_map *produce = rename_range(
+		_producer.GetAccess(_producer_tensor, AccessType::WRITE), _consumer_tensor.c_str());
+	isl_union_map *consume = _consumer.GetAccess(_consumer_tensor, AccessType::READ);
+	// element -> PE that produces/consumes it
+	isl_union_map *produce_pe = isl_union_map_apply_range(
+		isl_union_map_reverse(produce), _producer.GetSpaceMap());
+	isl_union_map *consume_pe = isl_union_map_apply_range(
+		isl_union_map_reverse(consume), _consumer.GetSpaceMap());
+
+	_intermediate = card(isl_union_set_intersect(
+		isl_union_map_domain(isl_union_map_copy(produce_pe)),
+		isl_union_map_domain(isl_union_map_copy(consume_pe))));
+
+	// elements that are consumed on the PE they are produced on can stay
+	// in L1, as long as every such PE has room for them
+	isl_union_map *local = isl_union_map_intersect(produce_pe, consume_pe);
+	double local_num = card(isl_union_map_domain(isl_union_map_copy(local)));
+	double local_pe_num = card(isl_union_map_range(local));
+	const PEArray &pe = _consumer.GetPEArray();
+	_pe_resident = min(local_num, (double)pe.GetL1Size() * local_pe_num);
+	_l2_resident = min(_intermediate - _pe_resident, (double)pe.GetL2Size());
+	_analyzed = true;
+}
+
+double
+FusedPair::GetIntermediateVolume()
+{
+	analyze();
+	return _intermediate;
+}
+
+double
+FusedPair::GetPEResidentVolume()
+{
+	analyze();
+	return _pe_resident;
+}
+
+double
+FusedPair::GetL2ResidentVolume()
+{
+	analyze();
+	return _l2_resident;
+}
+
+double
+FusedPair::GetDRAMSaving()
+{
+	analyze();
+	// one DRAM write by the producer and one DRAM read by the consumer
+	return 2 * (_pe_resident + _l2_resident);
+}
+
+// every tensor element crosses the chip boundary once when not fused
+double
+FusedPair::offchip_bits(Dataflow &df)
+{
+	double bits = 0;
+	auto [input, output] = df.GetTensorList();
+	for (auto& tensor : input)
+		bits += df.GetFootprint(tensor, AccessType::READ) *
+			df.GetBitsPerItem(tensor, AccessType::READ);
+	for (auto& tensor : output)
+		bits += df.GetFootprint(tensor, AccessType::WRITE) *
+			df.GetBitsPerItem(tensor, AccessType::WRITE);
+	return bits;
+}
+
+// bits of one element of the intermediate tensor as written by the producer
+double
+FusedPair::intermediate_bits()
+{
+	return _producer.GetBitsPerItem(_producer_tensor, AccessType::WRITE);
+}
+
+double
+FusedPair::layer_delay(
+	Dataflow &df,
+	double ingress_saving,
+	double egress_saving,
+	double dram_bits,
+	unsigned dram_bandwidth)
+{
+	unsigned bandwidth = df.GetPEArray().GetBandwidth();
+	isl_union_map *space_time_to_neighbor = df.MapSpaceTimeToNeighbor();
+	double ingress_delay = df.GetIngressDelay(isl_union_map_copy(space_time_to_neighbor)) -
+		ingress_saving / bandwidth;
+	double egress_delay = df.GetEgressDelay(space_time_to_neighbor) -
+		egress_saving / bandwidth;
+	double compute_delay = df.GetComputationDelay();
+	double dram_delay = dram_bits / dram_bandwidth;
+	return max(max(ingress_delay, egress_delay), max(compute_delay, dram_delay));
+}
+
+double
+FusedPair::GetUnfusedDelay(unsigned dram_bandwidth)
+{
+	return layer_delay(_producer, 0, 0, offchip_bits(_producer), dram_bandwidth) +
+		layer_delay(_consumer, 0, 0, offchip_bits(_consumer), dram_bandwidth);
+}
+
+double
+FusedPair::GetFusedDelay(unsigned dram_bandwidth)
+{
+	analyze();
+	// PE resident elements skip the egress of the producer and the ingress
+	// of the consumer, L2 resident elements only skip DRAM
+	double bits = intermediate_bits();
+	double saving = (_pe_resident + _l2_resident) * bits;
+	return layer_delay(_producer, 0, _pe_resident * bits,
+			offchip_bits(_producer) - saving, dram_bandwidth) +
+		layer_delay(_consumer, _pe_resident * bits, 0,
+			offchip_bits(_consumer) - saving, dram_bandwidth);
+}
+
+double
+FusedPair::GetUnfusedEnergy()
+{
+	double energy = _producer.GetEnergy(_producer.MapSpaceTimeToNeighbor()) +
+		_consumer.GetEnergy(_consumer.MapSpaceTimeToNeighbor());
+	energy += dram_multiplier *
+		(offchip_bits(_producer) + offchip_bits(_consumer)) / BIT_PER_ITEM;
+	return energy;
+}
+
+double
+FusedPair::GetFusedEnergy()
+{
+	analyze();
+	double energy = GetUnfusedEnergy();
+	double width = intermediate_bits() / BIT_PER_ITEM;
+	energy -= width * l2_multiplier * 2 * _pe_resident; // no L2 write and L2 read
+	energy -= width * dram_multiplier * GetDRAMSaving();
+	return energy;
+}
@@ -22,10 +22,15 @@ Mapping::Load(const char* filename)
 	ifstream input(filename);
 	if (!input.is_open())
 		return false;
+	return Load(input);
+}
+
+bool
+Mapping::Load(istream& input)
+{
 	string space_map_str, time_map_str;
 	getline(input, space_map_str);
 	getline(input, time_map_str);
-	input.close();
 
 	_space_map.reset(
 		isl_union_map_read_from_str(_context->ctx(), space_map_str.c_str())
@@ -33,9 +38,36 @@ Mapping::Load(const char* filename)
 	_time_map.reset(
 		isl_union_map_read_from_str(_context->ctx(), time_map_str.c_str())
 	);
+	if (!_space_map || !_time_map)
+		return false;
+	// an optional third line shards the instances over devices
+	string device_map_str;
+	while (getline(input, device_map_str))
+		if (device_map_str.find('{') != string::npos)
+		{
+			SetDeviceMap(device_map_str.c_str());
+			return _device_map != nullptr;
+		}
 	return true;
 }
 
+string
+Mapping::Serialize() const
+{
+	string ret = ToString(_space_map.get()) + "\n" + ToString(_time_map.get()) + "\n";
+	if (_device_map)
+		ret += ToString(_device_map.get()) + "\n";
+	return ret;
+}
+
+void
+Mapping::SetDeviceMap(const char* device_map_str)
+{
+	_device_map.reset(
+		isl_union_map_read_from_str(_context->ctx(), device_map_str)
+	);
+}
+
 
 void
 Mapping::PrintInfo() const
@@ -44,6 +76,11 @@ Mapping::PrintInfo() const
 	_context->printer(isl_printer_print_union_map, _space_map.get());
 	_context->printer(isl_printer_print_str, "\nTimeMap:\n");
 	_context->printer(isl_printer_print_union_map, _time_map.get());
+	if (_device_map)
+	{
+		_context->printer(isl_printer_print_str, "\nDeviceMap:\n");
+		_context->printer(isl_printer_print_union_map, _device_map.get());
+	}
 	_context->printer(isl_printer_end_line);
 }
 
@@ -57,5 +94,9 @@ Mapping::copy() const
 	result._time_map.reset(
 		isl_union_map_copy(_time_map.get())
 	);
+	if (_device_map)
+		result._device_map.reset(
+			isl_union_map_copy(_device_map.get())
+		);
 	return result;
 }
@@ -0,0 +1,530 @@
+#include "network.h"
+#include "parallel.h"
+
+#include <cctype>
+
+using namespace std;
+using namespace TENET;
+
+namespace
+{
+
+const unsigned MAX_EXPAND_DEPTH{32};
+
+// one line of a block body: [lhs =] callee(args) [(inputs)]
+struct Call
+{
+	string lhs;
+	string callee;
+	vector<string> positional;
+	vector<pair<string, string>> keyword;
+	vector<string> inputs;
+};
+
+string trim(const string& s)
+{
+	size_t begin = s.find_first_not_of(" \t\r\n");
+	if (begin == string::npos)
+		return "";
+	size_t end = s.find_last_not_of(" \t\r\n");
+	return s.substr(begin, end - begin + 1);
+}
+
+// split on commas that are not nested in brackets or quotes
+vector<string> split_args(const string& s)
+{
+	vector<string> ret;
+	int depth = 0;
+	bool quoted = false;
+	string cur;
+	for (char ch : s)
+	{
+		if (ch == '\'' || ch == '"')
+			quoted = !quoted;
+		else if (!quoted && (ch == '(' || ch == '['))
+			depth++;
+		else if (!quoted && (ch == ')' || ch == ']'))
+			depth--;
+		if (ch == ',' && depth == 0 && !quoted)
+		{
+			ret.push_back(trim(cur));
+			cur.clear();
+		}
+		else
+			cur.push_back(ch);
+	}
+	if (!trim(cur).empty())
+		ret.push_back(trim(cur));
+	return ret;
+}
+
+// returns the position after the bracket matching s[open]
+size_t match_paren(const string& s, size_t open)
+{
+	int depth = 0;
+	for (size_t i = open; i < s.size(); i++)
+	{
+		if (s[i] == '(')
+			depth++;
+		else if (s[i] == ')' && --depth == 0)
+			return i + 1;
+	}
+	return string::npos;
+}
+
+bool parse_call(const string& line, Call& call)
+{
+	size_t open = line.find('(');
+	if (open == string::npos)
+		return false;
+	size_t eq = line.find('=');
+	size_t callee_begin = 0;
+	if (eq != string::npos && eq < open)
+	{
+		call.lhs = trim(line.substr(0, eq));
+		callee_begin = eq + 1;
+	}
+	call.callee = trim(line.substr(callee_begin, open - callee_begin));
+	size_t close = match_paren(line, open);
+	if (close == string::npos)
+		return false;
+	for (auto& arg : split_args(line.substr(open + 1, close - open - 2)))
+	{
+		size_t pos = arg.find('=');
+		if (pos != string::npos && arg.find_first_of("([") > pos)
+			call.keyword.emplace_back(trim(arg.substr(0, pos)), trim(arg.substr(pos + 1)));
+		else
+			call.positional.push_back(arg);
+	}
+	size_t in_open = line.find('(', close);
+	if (in_open != string::npos)
+	{
+		size_t in_close = match_paren(line, in_open);
+		if (in_close == string::npos)
+			return false;
+		call.inputs = split_args(line.substr(in_open + 1, in_close - in_open - 2));
+	}
+	return true;
+}
+
+bool eval_int(const string& s, const map<string, int>& env, int& value)
+{
+	string v = trim(s);
+	if (v.empty())
+		return false;
+	if (isdigit(static_cast<unsigned char>(v[0])))
+	{
+		value = stoi(v);
+		return true;
+	}
+	auto iter = env.find(v);
+	if (iter == env.end())
+		return false;
+	value = iter->second;
+	return true;
+}
+
+// "3", "[3, 3]" and "(3, 3)" are all accepted
+bool eval_pair(const string& s, const map<string, int>& env, int& x, int& y)
+{
+	string v = trim(s);
+	if (!v.empty() && (v[0] == '[' || v[0] == '('))
+	{
+		auto items = split_args(v.substr(1, v.size() - 2));
+		if (items.empty() || !eval_int(items[0], env, x))
+			return false;
+		return items.size() < 2 ? (y = x, true) : eval_int(items[1], env, y);
+	}
+	if (!eval_int(v, env, x))
+		return false;
+	y = x;
+	return true;
+}
+
+const string* find_keyword(const Call& call, initializer_list<const char*> keys)
+{
+	for (auto& [key, value] : call.keyword)
+		for (auto k : keys)
+			if (key == k)
+				return &value;
+	return nullptr;
+}
+
+unsigned output_size(unsigned in, unsigned kernel, unsigned stride, bool same)
+{
+	if (same)
+		return (in + stride - 1) / stride;
+	return in < kernel ? 0 : (in - kernel) / stride + 1;
+}
+
+bool is_same_padding(const Call& call)
+{
+	const string* padding = find_keyword(call, {"padding"});
+	return padding != nullptr && padding->find("same") != string::npos;
+}
+
+bool read_file(const char* filename, string& content)
+{
+	ifstream input(filename);
+	if (!input.is_open())
+		return false;
+	content.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+	return true;
+}
+
+} // namespace
+
+string
+Layer::GetDomainStr() const
+{
+	char buf[MAX_STR_LEN];
+	snprintf(buf, MAX_STR_LEN,
+		"{S[k,c,ox,oy,rx,ry]:0<=k<%u and 0<=c<%u and 0<=ox<%u and 0<=oy<%u and 0<=rx<%u and 0<=ry<%u}",
+		k, c, ox, oy, rx, ry);
+	return buf;
+}
+
+bool
+Network::Load(
+	const char* filename,
+	unsigned in_height,
+	unsigned in_width,
+	unsigned in_channel,
+	const map<string, int>& params)
+{
+	ifstream input(filename);
+	if (!input.is_open())
+		return false;
+	_blocks.clear();
+	_layers.clear();
+	_top.clear();
+
+	string line;
+	Block* current = nullptr;
+	while (getline(input, line))
+	{
+		line = trim(line);
+		if (current != nullptr)
+		{
+			if (line == "}")
+				current = nullptr;
+			else if (!line.empty())
+				current->body.push_back(line);
+			continue;
+		}
+		size_t brace = line.find('{');
+		if (brace == string::npos)
+			continue;
+		string header = trim(line.substr(0, brace));
+		size_t open = header.find('(');
+		string name = trim(header.substr(0, open));
+		Block block;
+		if (open != string::npos)
+			block.params = split_args(header.substr(open + 1, header.rfind(')') - open - 1));
+		_blocks[name] = move(block);
+		current = &_blocks[name];
+		_top = name;
+	}
+	input.close();
+	if (_top.empty())
+		return false;
+
+	// the last block describes the whole network
+	map<string, int> env;
+	for (auto& param : _blocks[_top].params)
+	{
+		auto iter = params.find(param);
+		if (iter == params.end())
+		{
+			fprintf(stderr, "Network parameter %s is not bound\n", param.c_str());
+			return false;
+		}
+		env[param] = iter->second;
+	}
+	Shape output;
+	return expand(_top, env, Shape{in_channel, in_height, in_width}, _top, output, 0);
+}
+
+bool
+Network::expand(
+	const string& block_name,
+	const map<string, int>& env,
+	const Shape& input,
+	const string& prefix,
+	Shape& output,
+	unsigned depth)
+{
+	if (depth > MAX_EXPAND_DEPTH)
+		return false;
+	const Block& block = _blocks[block_name];
+	map<string, Shape> vars{{"input", input}};
+	Shape last = input;
+	for (unsigned line_no = 0; line_no < block.body.size(); line_no++)
+	{
+		Call call;
+		if (!parse_call(block.body[line_no], call) || call.callee.empty())
+			continue;
+		vector<Shape> in_shapes;
+		for (auto& name : call.inputs)
+		{
+			auto iter = vars.find(name);
+			if (iter == vars.end())
+			{
+				fprintf(stderr, "Unknown tensor %s in %s\n", name.c_str(), block_name.c_str());
+				return false;
+			}
+			in_shapes.push_back(iter->second);
+		}
+		// calls without explicit inputs consume the input of the block
+		if (in_shapes.empty())
+			in_shapes.push_back(vars["input"]);
+
+		string label = (call.lhs.empty() || call.lhs == "net" || call.lhs == "x") ?
+			call.callee : call.lhs;
+		string name = prefix + "/" + label + "_" + to_string(line_no);
+		Shape in = in_shapes[0], out = in;
+		string module = call.callee[0] == '_' ? call.callee.substr(1) : call.callee;
+
+		if (call.callee == "conv2d")
+		{
+			int k = 0, rx = 1, ry = 1, stride = 1, unused = 0;
+			const string* value = find_keyword(call, {"c", "num_outputs", "filters"});
+			// the kernel size is the positional argument after the channel number
+			unsigned kernel_pos = value != nullptr ? 0 : 1;
+			bool ok = value != nullptr ? eval_int(*value, env, k) :
+				(!call.positional.empty() && eval_int(call.positional[0], env, k));
+			if ((value = find_keyword(call, {"kernel_size"})) != nullptr)
+				ok = ok && eval_pair(*value, env, rx, ry);
+			else if (call.positional.size() > kernel_pos)
+				ok = ok && eval_pair(call.positional[kernel_pos], env, rx, ry);
+			if ((value = find_keyword(call, {"rx"})) != nullptr)
+				ok = ok && eval_int(*value, env, rx);
+			if ((value = find_keyword(call, {"ry"})) != nullptr)
+				ok = ok && eval_int(*value, env, ry);
+			if ((value = find_keyword(call, {"stride", "strides"})) != nullptr)
+				ok = ok && eval_pair(*value, env, stride, unused);
+			if (!ok || k <= 0 || rx <= 0 || ry <= 0 || stride <= 0)
+			{
+				fprintf(stderr, "Cannot evaluate %s\n", block.body[line_no].c_str());
+				return false;
+			}
+			bool same = is_same_padding(call);
+			Layer layer;
+			layer.name = name;
+			layer.type = LayerType::CONV2D;
+			layer.k = k;
+			layer.c = in.c;
+			layer.ox = output_size(in.w, rx, stride, same);
+			layer.oy = output_size(in.h, ry, stride, same);
+			layer.rx = rx;
+			layer.ry = ry;
+			layer.stride = stride;
+			_layers.push_back(layer);
+			out = Shape{layer.k, layer.oy, layer.ox};
+		}
+		else if (call.callee.find("pool") != string::npos)
+		{
+			int px = 1, py = 1, stride = 0, unused = 0;
+			const string* value = find_keyword(call, {"pool_size", "kernel_size"});
+			bool ok = value != nullptr ? eval_pair(*value, env, px, py) :
+				(!call.positional.empty() && eval_pair(call.positional[0], env, px, py));
+			if ((value = find_keyword(call, {"stride", "strides"})) != nullptr)
+				ok = ok && eval_pair(*value, env, stride, unused);
+			if (!ok)
+			{
+				fprintf(stderr, "Cannot evaluate %s\n", block.body[line_no].c_str());
+				return false;
+			}
+			if (stride <= 0)
+				stride = px;
+			bool same = is_same_padding(call);
+			out = Shape{in.c, output_size(in.h, py, stride, same), output_size(in.w, px, stride, same)};
+			Layer layer;
+			layer.name = name;
+			layer.type = LayerType::POOL;
+			layer.k = layer.c = in.c;
+			layer.ox = out.w;
+			layer.oy = out.h;
+			layer.rx = px;
+			layer.ry = py;
+			layer.stride = stride;
+			_layers.push_back(layer);
+		}
+		else if (call.callee == "concat")
+		{
+			out.c = 0;
+			for (auto& shape : in_shapes)
+				out.c += shape.c;
+			Layer layer;
+			layer.name = name;
+			layer.type = LayerType::CONCAT;
+			layer.k = layer.c = out.c;
+			layer.ox = out.w;
+			layer.oy = out.h;
+			_layers.push_back(layer);
+		}
+		else if (_blocks.count(module) != 0 && module != block_name)
+		{
+			// bind arguments to module parameters, keywords that do not name
+			// a parameter are bound in order like positional arguments
+			const Block& callee = _blocks[module];
+			map<string, int> callee_env;
+			vector<string> values = call.positional;
+			for (auto& [key, value] : call.keyword)
+			{
+				auto pos = find(callee.params.begin(), callee.params.end(), key);
+				if (pos == callee.params.end())
+					values.push_back(value);
+				else if (!eval_int(value, env, callee_env[key]))
+					return false;
+			}
+			unsigned next = 0;
+			for (auto& param : callee.params)
+			{
+				if (callee_env.count(param) != 0)
+					continue;
+				if (next >= values.size() || !eval_int(values[next++], env, callee_env[param]))
+				{
+					fprintf(stderr, "Cannot bind %s of %s\n", param.c_str(), module.c_str());
+					return false;
+				}
+			}
+			if (!expand(module, callee_env, in, name, out, depth + 1))
+				return false;
+		}
+		// other calls (activation, squeeze, flatten...) keep the shape
+
+		if (!call.lhs.empty())
+			vars[call.lhs] = out;
+		last = out;
+	}
+	output = last;
+	return true;
+}
+
+Statement
+Network::GetStatement(shared_ptr<ISL_Context> context, unsigned idx) const
+{
+	const Layer& layer = _layers[idx];
+	Statement st(context, layer.GetDomainStr().c_str());
+	char buf[MAX_STR_LEN];
+	snprintf(buf, MAX_STR_LEN, "{S[k,c,ox,oy,rx,ry]->I[c,ox*%u+rx,oy*%u+ry]}",
+		layer.stride, layer.stride);
+	st.AddAccess(Access{context, "I", buf, false});
+	st.AddAccess(Access{context, "W", "{S[k,c,ox,oy,rx,ry]->W[k,c,rx,ry]}", false});
+	st.AddAccess(Access{context, "O", "{S[k,c,ox,oy,rx,ry]->O[k,ox,oy]}", true});
+	return st;
+}
+
+bool
+Network::Analyze(
+	const char* pe_file,
+	const char* mapping_file,
+	vector<LayerResult>& results,
+	const char* pointwise_mapping_file,
+	unsigned num_threads) const
+{
+	auto template_of = [&](const Layer& layer)
+	{
+		return (pointwise_mapping_file != nullptr && layer.IsPointwise()) ?
+			pointwise_mapping_file : mapping_file;
+	};
+
+	// read and check the pe array and mapping templates once for all layers
+	map<string, string> texts; // file -> content
+	{
+		shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+		PEArray pe(context);
+		bool ok = read_file(pe_file, texts[pe_file]);
+		istringstream pe_input(texts[pe_file]);
+		if (!ok || !pe.Load(pe_input))
+		{
+			fprintf(stderr, "Load PE %s failed\n", pe_file);
+			return false;
+		}
+		for (const char* file : {mapping_file, pointwise_mapping_file})
+		{
+			if (file == nullptr)
+				continue;
+			Mapping mp(context);
+			ok = read_file(file, texts[file]);
+			istringstream mp_input(texts[file]);
+			if (!ok || !mp.Load(mp_input))
+			{
+				fprintf(stderr, "Load Mapping %s failed\n", file);
+				return false;
+			}
+			// the layer metrics see a single array
+			if (mp.HasDeviceMap())
+			{
+				fprintf(stderr, "Mapping %s has a device map\n", file);
+				return false;
+			}
+		}
+	}
+
+	// group conv2d layers by shape, the pe array is the same for all of them
+	results.assign(_layers.size(), LayerResult{});
+	vector<unsigned> unique;          // representative layer of each shape
+	vector<vector<unsigned>> members; // all layers of each shape
+	{
+		shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+		map<string, unsigned> shape_ids;
+		for (unsigned i = 0; i < _layers.size(); i++)
+		{
+			const Layer& layer = _layers[i];
+			if (layer.type != LayerType::CONV2D || layer.ox == 0 || layer.oy == 0)
+				continue;
+			string key = GetStatement(context, i).GetCanonicalKey() + "|" + template_of(layer);
+			auto [iter, inserted] = shape_ids.emplace(key, unique.size());
+			if (inserted)
+			{
+				unique.push_back(i);
+				members.emplace_back();
+			}
+			members[iter->second].push_back(i);
+			results[i].shape_id = iter->second;
+		}
+	}
+
+	// every worker owns an isl_ctx, nothing ISL is shared between threads
+	num_threads = GetThreadNum(num_threads, unique.size());
+	vector<shared_ptr<ISL_Context>> contexts(num_threads);
+	ParallelFor(unique.size(), num_threads, [&](unsigned worker, unsigned job)
+	{
+		if (!contexts[worker])
+			contexts[worker] = make_shared<ISL_Context>(stdout);
+		shared_ptr<ISL_Context> context = contexts[worker];
+		unsigned idx = unique[job];
+
+		PEArray pe(context);
+		Mapping mp(context);
+		istringstream pe_input(texts.at(pe_file)), mp_input(texts.at(template_of(_layers[idx])));
+		pe.Load(pe_input);
+		mp.Load(mp_input);
+		Dataflow df(GetStatement(context, idx), move(pe), move(mp));
+		isl_union_map *space_time_to_neighbor = df.MapSpaceTimeToNeighbor();
+
+		LayerResult result;
+		result.mac = df.GetMacNum();
+		result.delay = df.GetDelay(isl_union_map_copy(space_time_to_neighbor));
+		result.energy = df.GetEnergy(space_time_to_neighbor);
+		result.offchip = df.GetFootprint("", AccessType::READ) +
+			df.GetFootprint("", AccessType::WRITE);
+		result.analyzed = true;
+		result.shape_id = job;
+		for (auto member : members[job])
+			results[member] = result;
+	});
+	return true;
+}
+
+void
+Network::PrintInfo(FILE* file) const
+{
+	const char* type_name[] = {"conv2d", "pool", "concat"};
+	for (auto& layer : _layers)
+		fprintf(file, "%s %s k=%u c=%u ox=%u oy=%u rx=%u ry=%u stride=%u\n",
+			layer.name.c_str(), type_name[static_cast<int>(layer.type)],
+			layer.k, layer.c, layer.ox, layer.oy, layer.rx, layer.ry, layer.stride);
+}
@@ -6,6 +6,7 @@ using namespace TENET;
 PEArray::PEArray(shared_ptr<ISL_Context> context):
 	_domain(nullptr),
 	_interconnect(nullptr),
+	_multicast(nullptr),
 	_context(context)
 {}
 
@@ -26,6 +27,7 @@ PEArray::PEArray(
 			isl_union_set_copy(_domain.get())
 		)
 	),
+	_multicast(nullptr),
 	_l1size(l1size),
 	_l2size(l2size),
 	_bandwidth(bandwidth),
@@ -39,6 +41,12 @@ PEArray::Load(const char* filename)
 	ifstream input(filename);
 	if (!input.is_open())
 		return false;
+	return Load(input);
+}
+
+bool
+PEArray::Load(istream& input)
+{
 	string domain_str, interconnect_str;
 	getline(input, domain_str);
 	getline(input, interconnect_str);
@@ -49,8 +57,105 @@ PEArray::Load(const char* filename)
 	_interconnect.reset(
 		isl_union_map_read_from_str(_context->ctx(), interconnect_str.c_str())
 	);
+	if (!_domain || !_interconnect)
+		return false;
 	input >> _l1size >> _l2size >> _bandwidth >> _avg_latency;
-	input.close();
+	// optional keyword lines follow, e.g. "multicast {PE[i,j]->Bus[i]}" or
+	// "level <name> <bandwidth> <latency> <buffer> {PE->cluster} {PE->PE}"
+	string line;
+	while (getline(input, line))
+	{
+		size_t pos = line.find_first_not_of(" \t");
+		if (pos == string::npos)
+			continue;
+		string keyword = line.substr(pos, line.find_first_of(" \t{", pos) - pos);
+		if (keyword == "multicast")
+			SetMulticast(line.substr(pos + keyword.size()).c_str());
+		else if (keyword == "level")
+		{
+			istringstream args(line.substr(pos + keyword.size()));
+			string name, cluster_str, interconnect_str;
+			unsigned bandwidth = 0, avg_latency = 0, buffer = 0;
+			args >> name >> bandwidth >> avg_latency >> buffer;
+			getline(args, cluster_str);
+			size_t split = cluster_str.find('}');
+			if (split != string::npos)
+			{
+				interconnect_str = cluster_str.substr(split + 1);
+				cluster_str = cluster_str.substr(0, split + 1);
+			}
+			if (bandwidth == 0 || !AddLevel(name.c_str(), bandwidth, avg_latency, buffer,
+				cluster_str.c_str(), interconnect_str.c_str()))
+			{
+				fprintf(stderr, "Invalid PE array level %s\n", line.c_str());
+				return false;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Unknown PE array option %s\n", keyword.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+string
+PEArray::Serialize() const
+{
+	ostringstream out;
+	out << ToString(_domain.get()) << "\n" << ToString(_interconnect.get()) << "\n"
+		<< _l1size << " " << _l2size << " " << _bandwidth << " " << _avg_latency << "\n";
+	if (_multicast)
+		out << "multicast " << ToString(_multicast.get()) << "\n";
+	for (auto& level : _levels)
+		out << "level " << level.name << " " << level.bandwidth << " " << level.avg_latency << " "
+			<< level.buffer << " " << ToString(level.cluster.get()) << " "
+			<< ToString(level.interconnect.get()) << "\n";
+	return out.str();
+}
+
+void
+PEArray::SetMulticast(const char* multicast_str)
+{
+	_multicast.reset(
+		isl_union_map_intersect_domain(
+			isl_union_map_read_from_str(_context->ctx(), multicast_str),
+			isl_union_set_copy(_domain.get()))
+	);
+}
+
+bool
+PEArray::AddLevel(
+	const char* name,
+	unsigned bandwidth,
+	unsigned avg_latency,
+	unsigned buffer,
+	const char* cluster_str,
+	const char* interconnect_str)
+{
+	PELevel level;
+	level.name = name;
+	level.bandwidth = bandwidth;
+	level.avg_latency = avg_latency;
+	level.buffer = buffer;
+	level.cluster.reset(
+		isl_union_map_intersect_domain(
+			isl_union_map_read_from_str(_context->ctx(), cluster_str),
+			isl_union_set_copy(_domain.get()))
+	);
+	isl_union_map *interconnect = isl_union_map_read_from_str(_context->ctx(), interconnect_str);
+	if (!level.cluster || !interconnect)
+	{
+		isl_union_map_free(interconnect);
+		return false;
+	}
+	// a level network only links PEs of the same cluster
+	isl_union_map *same_cluster = isl_union_map_apply_range(
+		isl_union_map_copy(level.cluster.get()),
+		isl_union_map_reverse(isl_union_map_copy(level.cluster.get())));
+	level.interconnect.reset(isl_union_map_intersect(interconnect, same_cluster));
+	_levels.push_back(move(level));
 	return true;
 }
 
@@ -61,6 +166,19 @@ PEArray::PrintInfo() const
 	_context->printer(isl_printer_print_union_set, _domain.get());
 	_context->printf("\ninterconnection: ");
 	_context->printer(isl_printer_print_union_map, _interconnect.get());
+	if (_multicast)
+	{
+		_context->printf("\nmulticast: ");
+		_context->printer(isl_printer_print_union_map, _multicast.get());
+	}
+	for (auto& level : _levels)
+	{
+		_context->printf("\nlevel %s: bandwidth %u, latency %u, buffer %u\n cluster: ",
+			level.name.c_str(), level.bandwidth, level.avg_latency, level.buffer);
+		_context->printer(isl_printer_print_union_map, level.cluster.get());
+		_context->printf("\n interconnection: ");
+		_context->printer(isl_printer_print_union_map, level.interconnect.get());
+	}
 	_context->printf("\nL1Size: %u\nL2Size: %u\nBandwidth: %u\n", _l1size, _l2size, _bandwidth);
 }
 
@@ -74,6 +192,21 @@ PEArray::copy() const
 	result._interconnect.reset(
 		isl_union_map_copy(_interconnect.get())
 	);
+	if (_multicast)
+		result._multicast.reset(
+			isl_union_map_copy(_multicast.get())
+		);
+	for (auto& level : _levels)
+	{
+		PELevel copy;
+		copy.name = level.name;
+		copy.cluster.reset(isl_union_map_copy(level.cluster.get()));
+		copy.interconnect.reset(isl_union_map_copy(level.interconnect.get()));
+		copy.bandwidth = level.bandwidth;
+		copy.avg_latency = level.avg_latency;
+		copy.buffer = level.buffer;
+		result._levels.push_back(move(copy));
+	}
 	result._l1size = _l1size;
 	result._l2size = _l2size;
 	result._bandwidth = _bandwidth;
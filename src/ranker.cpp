@@ -0,0 +1,372 @@
+#include "ranker.h"
+#include "parallel.h"
+#include <random>
+
+using namespace std;
+using namespace TENET;
+
+namespace
+{
+
+bool read_file(const char* filename, string& content)
+{
+	ifstream input(filename);
+	if (!input.is_open())
+		return false;
+	content.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+	return true;
+}
+
+struct BoundArgs
+{
+	unsigned dim;
+	long value;
+	bool fix; // dim == value, otherwise dim >= value
+	isl_union_set *result;
+};
+
+isl_stat bound_dim(isl_set *set, void *user)
+{
+	auto args = static_cast<BoundArgs*>(user);
+	if ((unsigned)isl_set_dim(set, isl_dim_set) > args->dim)
+		set = args->fix ? isl_set_fix_si(set, isl_dim_set, args->dim, args->value) :
+			isl_set_lower_bound_si(set, isl_dim_set, args->dim, args->value);
+	args->result = isl_union_set_add_set(args->result, set);
+	return isl_stat_ok;
+}
+
+// uset is freed
+isl_union_set *bound(isl_union_set *uset, unsigned dim, long value, bool fix)
+{
+	BoundArgs args{dim, value, fix, isl_union_set_empty(isl_union_set_get_space(uset))};
+	isl_union_set_foreach_set(uset, bound_dim, &args);
+	isl_union_set_free(uset);
+	return args.result;
+}
+
+// min (or max) of dim over the points of a small uset, uset is freed
+long extreme(isl_union_set *uset, unsigned dim, bool is_max)
+{
+	auto points = EvaluateOnPoints(uset, {});
+	long ret = points.empty() ? 0 : points[0].coords[dim];
+	for (auto& point : points)
+		ret = is_max ? max(ret, point.coords[dim]) : min(ret, point.coords[dim]);
+	return ret;
+}
+
+// number of points of uset, uset is freed
+double count(isl_union_set *uset)
+{
+	return convert_upwqp_to_int(isl_union_set_card(uset));
+}
+
+/*
+* random_stamp: a time stamp drawn uniformly from the stamp_num stamps. With
+* the dims before d fixed, stamps are ordered by decreasing dim d and the one
+* at a random index is kept: dim d is fixed by a binary search for the largest
+* value with more than index stamps at or above it.
+*/
+isl_union_set *random_stamp(isl_union_set *time_domain, unsigned dims, double stamp_num, mt19937& rng)
+{
+	double index = uniform_int_distribution<long long>(0, (long long)stamp_num - 1)(rng);
+	isl_union_set *slab = time_domain;
+	for (unsigned d = 0; d < dims; d++)
+	{
+		long lo = extreme(isl_union_set_lexmin(isl_union_set_copy(slab)), d, false);
+		long hi = extreme(isl_union_set_lexmax(isl_union_set_copy(slab)), d, true);
+		while (lo < hi)
+		{
+			long mid = lo + (hi - lo + 1) / 2;
+			if (count(bound(isl_union_set_copy(slab), d, mid, false)) > index)
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+		index -= count(bound(isl_union_set_copy(slab), d, lo + 1, false));
+		slab = bound(slab, d, lo, true);
+	}
+	return slab;
+}
+
+isl_stat collect_stamp(isl_point *pnt, void *user)
+{
+	static_cast<vector<isl_union_set*>*>(user)->push_back(isl_union_set_from_point(pnt));
+	return isl_stat_ok;
+}
+
+// dataflow of the instances run at the time stamps in times, times is freed
+Dataflow at_times(Dataflow& df, isl_union_set *times)
+{
+	return df.Restrict(isl_union_set_apply(times, isl_union_map_reverse(df.GetTimeMap())));
+}
+
+// mapping dependent terms of one time stamp
+struct StampSample
+{
+	double ingress_bits{0};
+	double egress_bits{0};
+	double l2_energy{0}; // L2 reads and writes and multicast fanout
+	std::map<std::vector<long>, double> pe_mac; // MACs of every active PE
+};
+
+/*
+* sample_stamp: the unique volume of a stamp, with reuse from the stamp before
+* it, is that of both stamps minus that of the stamp before alone. stamp and
+* prev are freed, prev may be empty.
+*/
+StampSample sample_stamp(Dataflow& df, isl_union_set *stamp, isl_union_set *prev)
+{
+	StampSample sample;
+	Dataflow both = at_times(df, isl_union_set_union(isl_union_set_copy(stamp), isl_union_set_copy(prev)));
+	Dataflow before = at_times(df, prev);
+	Dataflow now = at_times(df, stamp);
+	auto [input, output] = df.GetTensorList();
+	for (auto& tensor : input)
+	{
+		double width = df.GetBitsPerItem(tensor, AccessType::READ) / BIT_PER_ITEM;
+		double unique = both.GetUniqueVolume(tensor, AccessType::READ, both.MapSpaceTimeToNeighbor()) -
+			before.GetUniqueVolume(tensor, AccessType::READ, before.MapSpaceTimeToNeighbor());
+		double fanout = both.GetMulticastFanout(tensor, both.MapSpaceTimeToNeighbor()) -
+			before.GetMulticastFanout(tensor, before.MapSpaceTimeToNeighbor());
+		sample.ingress_bits += width * BIT_PER_ITEM * unique;
+		// GetL2Read and GetL2Write are both the unique volume
+		sample.l2_energy += width * (2 * l2_multiplier * unique + fanout_multiplier * fanout);
+	}
+	for (auto& tensor : output)
+	{
+		double width = df.GetBitsPerItem(tensor, AccessType::WRITE) / BIT_PER_ITEM;
+		double unique = both.GetUniqueVolume(tensor, AccessType::WRITE, both.MapSpaceTimeToNeighbor()) -
+			before.GetUniqueVolume(tensor, AccessType::WRITE, before.MapSpaceTimeToNeighbor());
+		sample.egress_bits += width * BIT_PER_ITEM * unique;
+		sample.l2_energy += width * 2 * l2_multiplier * unique;
+	}
+	for (auto& point : EvaluateOnPoints(now.GetSpaceDomain(), {now.GetMacNumMap()}))
+		sample.pe_mac[point.coords] = point.values[0];
+	return sample;
+}
+
+// mean and standard error of the sum over a population of size n
+pair<double, double> scale_up(const vector<double>& values, double n, bool is_population)
+{
+	double mean = 0, var = 0;
+	for (double v : values)
+		mean += v / values.size();
+	for (double v : values)
+		var += (v - mean) * (v - mean) / max<size_t>(1, values.size() - 1);
+	double error = is_population ? 0 : n * sqrt(var / values.size());
+	return {n * mean, error};
+}
+
+// P(a > b) for normal estimates
+double probability_greater(double a, double a_error, double b, double b_error)
+{
+	double error = sqrt(a_error * a_error + b_error * b_error);
+	if (error == 0)
+		return a > b ? 1 : (a == b ? 0.5 : 0);
+	return 0.5 * erfc(-(a - b) / error / sqrt(2.0));
+}
+
+} // namespace
+
+Ranker::Ranker(unsigned samples, unsigned seed):
+	_samples(max(1u, samples)),
+	_seed(seed)
+{}
+
+bool
+Ranker::Load(const char* pe_file, const char* statement_file)
+{
+	if (!read_file(pe_file, _pe) || !read_file(statement_file, _statement))
+		return false;
+	shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+	PEArray pe(context);
+	Statement st(context);
+	istringstream pe_input(_pe), st_input(_statement);
+	return pe.Load(pe_input) && st.Load(st_input);
+}
+
+bool
+Ranker::AddMapping(const char* mapping_file)
+{
+	string text;
+	if (!read_file(mapping_file, text))
+		return false;
+	shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+	Mapping mp(context);
+	istringstream input(text);
+	if (!mp.Load(input))
+		return false;
+	// the estimates and exact metrics see a single array
+	if (mp.HasDeviceMap())
+	{
+		fprintf(stderr, "Mapping %s has a device map, rank the mappings of one device\n", mapping_file);
+		return false;
+	}
+	_mappings.emplace_back(mapping_file, text);
+	return true;
+}
+
+pair<double, double>
+Ranker::estimate(Dataflow& df, RankMetric metric, double fixed_energy, unsigned seed) const
+{
+	isl_union_set *time_domain = df.GetTimeDomain();
+	double stamp_num = df.GetTotalTime();
+	unsigned dims = 0;
+	{
+		auto first = EvaluateOnPoints(isl_union_set_lexmin(isl_union_set_copy(time_domain)), {});
+		dims = first.empty() ? 0 : first[0].coords.size();
+	}
+	vector<isl_union_set*> stamps;
+	bool is_population = stamp_num <= _samples;
+	if (is_population)
+		isl_union_set_foreach_point(time_domain, collect_stamp, &stamps);
+	else
+	{
+		mt19937 rng(seed);
+		for (unsigned i = 0; i < _samples; i++)
+			stamps.push_back(random_stamp(isl_union_set_copy(time_domain), dims, stamp_num, rng));
+	}
+
+	vector<double> ingress, egress, energy;
+	vector<map<vector<long>, double>> pe_mac;
+	for (auto stamp : stamps)
+	{
+		isl_union_set *prev = isl_union_set_lexmax(isl_union_map_domain(
+			isl_union_set_lex_lt_union_set(isl_union_set_copy(time_domain), isl_union_set_copy(stamp))));
+		StampSample sample = sample_stamp(df, stamp, prev);
+		ingress.push_back(sample.ingress_bits);
+		egress.push_back(sample.egress_bits);
+		energy.push_back(sample.l2_energy);
+		pe_mac.push_back(move(sample.pe_mac));
+	}
+	isl_union_set_free(time_domain);
+	if (stamps.empty())
+		return {metric == RankMetric::ENERGY ? fixed_energy : 0, 0};
+
+	if (metric == RankMetric::ENERGY)
+	{
+		auto [value, error] = scale_up(energy, stamp_num, is_population);
+		return {fixed_energy + value, error};
+	}
+	// the delay model of GetIngressDelay, GetEgressDelay and GetComputationDelay
+	const PEArray& pe = df.GetPEArray();
+	auto [ingress_bits, ingress_error] = scale_up(ingress, stamp_num, is_population);
+	auto [egress_bits, egress_error] = scale_up(egress, stamp_num, is_population);
+	// GetComputationDelay is the total MACs of the busiest PE, every PE is
+	// scaled up over the samples before taking the max
+	map<vector<long>, vector<double>> macs; // PE -> MACs at every sample
+	for (unsigned i = 0; i < pe_mac.size(); i++)
+		for (auto& [coords, mac] : pe_mac[i])
+		{
+			auto& values = macs[coords];
+			values.resize(pe_mac.size(), 0);
+			values[i] = mac;
+		}
+	double compute_delay = 0, compute_error = 0;
+	for (auto& [coords, values] : macs)
+	{
+		auto [value, error] = scale_up(values, stamp_num, is_population);
+		if (value > compute_delay)
+		{
+			compute_delay = value;
+			compute_error = error;
+		}
+	}
+	double ingress_delay = transfer_delay(ingress_bits, pe.GetBandwidth(), pe.GetAvgLatency());
+	double egress_delay = transfer_delay(egress_bits, pe.GetBandwidth(), pe.GetAvgLatency());
+	if (ingress_delay >= egress_delay && ingress_delay >= compute_delay)
+		return {ingress_delay, ingress_error / pe.GetBandwidth()};
+	if (egress_delay >= compute_delay)
+		return {egress_delay, egress_error / pe.GetBandwidth()};
+	return {compute_delay, compute_error};
+}
+
+Ranking
+Ranker::Rank(RankMetric metric, unsigned top_k, unsigned num_threads) const
+{
+	Ranking ranking;
+	if (_mappings.empty())
+		return ranking;
+	ranking.top_k = min<size_t>(top_k, _mappings.size());
+	auto dataflow = [&](shared_ptr<ISL_Context> context, unsigned i)
+	{
+		return Dataflow::Deserialize(context, DataflowText{_statement, _pe, _mappings[i].second});
+	};
+
+	// MACs and L1 accesses only depend on the statement
+	double fixed_energy = 0;
+	if (metric == RankMetric::ENERGY)
+	{
+		shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+		auto df = dataflow(context, 0);
+		fixed_energy = df->GetMacNum();
+		auto [input, output] = df->GetTensorList();
+		for (auto [tensors, type] : {make_pair(input, AccessType::READ), make_pair(output, AccessType::WRITE)})
+			for (auto& tensor : tensors)
+				fixed_energy += df->GetBitsPerItem(tensor, type) / BIT_PER_ITEM * l1_multiplier *
+					(df->GetL1Read(tensor, type) + df->GetL1Write(tensor, type));
+	}
+
+	// every worker owns an isl_ctx, nothing ISL is shared between threads
+	num_threads = GetThreadNum(num_threads, _mappings.size());
+	vector<shared_ptr<ISL_Context>> contexts(num_threads);
+	vector<RankedMapping> estimated(_mappings.size());
+	ParallelFor(_mappings.size(), num_threads, [&](unsigned worker, unsigned job)
+	{
+		if (!contexts[worker])
+			contexts[worker] = make_shared<ISL_Context>(stdout);
+		auto df = dataflow(contexts[worker], job);
+		estimated[job].name = _mappings[job].first;
+		if (!df)
+		{
+			estimated[job].estimate = HUGE_VAL;
+			return;
+		}
+		tie(estimated[job].estimate, estimated[job].error) =
+			estimate(*df, metric, fixed_energy, _seed + job);
+	});
+	vector<unsigned> order(_mappings.size());
+	for (unsigned i = 0; i < order.size(); i++)
+		order[i] = i;
+	stable_sort(order.begin(), order.end(),
+		[&](unsigned a, unsigned b) { return estimated[a].estimate < estimated[b].estimate; });
+	vector<RankedMapping> mappings;
+	for (unsigned i : order)
+		mappings.push_back(estimated[i]);
+
+	// exact metrics of the top-k
+	ParallelFor(ranking.top_k, GetThreadNum(num_threads, ranking.top_k), [&](unsigned worker, unsigned job)
+	{
+		if (!contexts[worker])
+			contexts[worker] = make_shared<ISL_Context>(stdout);
+		auto df = dataflow(contexts[worker], order[job]);
+		if (!df)
+			return;
+		mappings[job].exact = metric == RankMetric::DELAY ?
+			df->GetDelay(df->MapSpaceTimeToNeighbor()) : df->GetEnergy(df->MapSpaceTimeToNeighbor());
+		mappings[job].exact_valid = true;
+	});
+
+	if (ranking.top_k > 0)
+	{
+		auto& worst = mappings[ranking.top_k - 1];
+		for (unsigned i = ranking.top_k; i < mappings.size(); i++)
+			ranking.confidence *= probability_greater(mappings[i].estimate, mappings[i].error,
+				worst.estimate, worst.error);
+	}
+	double concordant = 0, pairs = 0;
+	for (unsigned i = 0; i < ranking.top_k; i++)
+		for (unsigned j = i + 1; j < ranking.top_k; j++)
+		{
+			// i has the better estimate
+			double diff = mappings[j].exact - mappings[i].exact;
+			concordant += diff > 0 ? 1 : (diff < 0 ? -1 : 0);
+			pairs++;
+		}
+	if (pairs > 0)
+		ranking.agreement = concordant / pairs;
+	stable_sort(mappings.begin(), mappings.begin() + ranking.top_k,
+		[](auto& a, auto& b) { return a.exact < b.exact; });
+	ranking.mappings = move(mappings);
+	return ranking;
+}
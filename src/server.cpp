@@ -0,0 +1,410 @@
+#include "server.h"
+#include "parallel.h"
+#include <climits>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace TENET;
+
+namespace
+{
+
+// a value of a flat JSON object: string, number, list of strings or literal
+struct JsonValue
+{
+	string str;
+	vector<string> list;
+};
+
+void skip_space(const string& s, size_t& pos)
+{
+	while (pos < s.size() && isspace((unsigned char)s[pos]))
+		pos++;
+}
+
+bool parse_string(const string& s, size_t& pos, string& out)
+{
+	if (pos >= s.size() || s[pos] != '"')
+		return false;
+	out.clear();
+	for (pos++; pos < s.size(); pos++)
+	{
+		char c = s[pos];
+		if (c == '"')
+		{
+			pos++;
+			return true;
+		}
+		if (c == '\\' && pos + 1 < s.size())
+		{
+			c = s[++pos];
+			switch (c)
+			{
+			case 'n': out += '\n'; break;
+			case 't': out += '\t'; break;
+			case 'r': out += '\r'; break;
+			default: out += c; break; // \" \\ \/
+			}
+		}
+		else
+			out += c;
+	}
+	return false;
+}
+
+bool parse_value(const string& s, size_t& pos, JsonValue& value)
+{
+	skip_space(s, pos);
+	if (pos >= s.size())
+		return false;
+	if (s[pos] == '"')
+		return parse_string(s, pos, value.str);
+	if (s[pos] == '[')
+	{
+		pos++;
+		skip_space(s, pos);
+		if (pos < s.size() && s[pos] == ']')
+		{
+			pos++;
+			return true;
+		}
+		while (pos < s.size())
+		{
+			JsonValue item;
+			if (!parse_value(s, pos, item))
+				return false;
+			value.list.push_back(item.str);
+			skip_space(s, pos);
+			if (pos < s.size() && s[pos] == ',')
+				pos++;
+			else
+				break;
+		}
+		skip_space(s, pos);
+		if (pos >= s.size() || s[pos] != ']')
+			return false;
+		pos++;
+		return true;
+	}
+	// number, true, false or null, kept as text
+	size_t end = s.find_first_of(",}] \t", pos);
+	value.str = s.substr(pos, end - pos);
+	pos = end;
+	return !value.str.empty();
+}
+
+bool parse_object(const string& s, map<string, JsonValue>& object)
+{
+	size_t pos = 0;
+	skip_space(s, pos);
+	if (pos >= s.size() || s[pos] != '{')
+		return false;
+	pos++;
+	skip_space(s, pos);
+	if (pos < s.size() && s[pos] == '}')
+		return true;
+	while (pos < s.size())
+	{
+		string key;
+		skip_space(s, pos);
+		if (!parse_string(s, pos, key))
+			return false;
+		skip_space(s, pos);
+		if (pos >= s.size() || s[pos] != ':')
+			return false;
+		pos++;
+		if (!parse_value(s, pos, object[key]))
+			return false;
+		skip_space(s, pos);
+		if (pos < s.size() && s[pos] == ',')
+			pos++;
+		else
+			break;
+	}
+	return pos < s.size() && s[pos] == '}';
+}
+
+string quote(const string& s)
+{
+	string out = "\"";
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+			out += '\\';
+		if (c == '\n')
+			out += "\\n";
+		else
+			out += c;
+	}
+	return out + "\"";
+}
+
+// inline text is used as is, anything else is a path to read
+bool resolve(const string& value, string& text)
+{
+	if (value.find('\n') != string::npos || (!value.empty() && value[0] == '{'))
+	{
+		text = value;
+		return true;
+	}
+	ifstream input(value);
+	if (!input.is_open())
+		return false;
+	text.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+	return true;
+}
+
+} // namespace
+
+AnalysisServer::AnalysisServer(unsigned num_workers, unsigned max_cached_dataflows):
+	_max_cached_dataflows(max_cached_dataflows)
+{
+	num_workers = GetThreadNum(num_workers, UINT_MAX);
+	for (unsigned i = 0; i < num_workers; i++)
+		_workers.push_back(make_unique<Worker>());
+	for (auto& worker : _workers)
+	{
+		worker->context = make_shared<ISL_Context>(stdout);
+		worker->thread = thread([this, &worker] { run(*worker); });
+	}
+}
+
+AnalysisServer::~AnalysisServer()
+{
+	for (auto& worker : _workers)
+	{
+		{
+			lock_guard<mutex> lock(worker->mutex);
+			worker->stop = true;
+		}
+		worker->ready.notify_one();
+	}
+	for (auto& worker : _workers)
+		worker->thread.join();
+}
+
+const vector<string>&
+AnalysisServer::GetMetricNames()
+{
+	static const vector<string> names{
+		"mac", "delay", "energy", "ingress_delay", "egress_delay", "compute_delay",
+		"active_pe", "average_active_pe", "total_time", "footprint"
+	};
+	return names;
+}
+
+void
+AnalysisServer::run(Worker& worker)
+{
+	while (true)
+	{
+		Job job;
+		{
+			unique_lock<mutex> lock(worker.mutex);
+			worker.ready.wait(lock, [&] { return worker.stop || !worker.jobs.empty(); });
+			if (worker.jobs.empty())
+				return;
+			job = move(worker.jobs.front());
+			worker.jobs.pop_front();
+		}
+		job.reply(handle(worker, job));
+	}
+}
+
+double
+AnalysisServer::evaluate(Dataflow& df, const string& metric, bool& valid)
+{
+	valid = true;
+	if (metric == "mac")
+		return df.GetMacNum();
+	if (metric == "delay")
+		return df.GetDelay(df.MapSpaceTimeToNeighbor());
+	if (metric == "energy")
+		return df.GetEnergy(df.MapSpaceTimeToNeighbor());
+	if (metric == "ingress_delay")
+		return df.GetIngressDelay(df.MapSpaceTimeToNeighbor());
+	if (metric == "egress_delay")
+		return df.GetEgressDelay(df.MapSpaceTimeToNeighbor());
+	if (metric == "compute_delay")
+		return df.GetComputationDelay();
+	if (metric == "active_pe")
+		return df.GetActivePENum();
+	if (metric == "average_active_pe")
+		return df.GetAverageActivePENum();
+	if (metric == "total_time")
+		return df.GetTotalTime();
+	if (metric == "footprint")
+		return df.GetFootprint("", AccessType::READ) + df.GetFootprint("", AccessType::WRITE);
+	valid = false;
+	return 0;
+}
+
+string
+AnalysisServer::handle(Worker& worker, const Job& job)
+{
+	string response = "{\"id\": " + job.request_id;
+	// a malformed inline statement may throw, it must not take the worker
+	// thread and the whole server down with it
+	try
+	{
+		auto iter = worker.dataflows.find(job.key);
+		if (iter == worker.dataflows.end())
+		{
+			if (worker.dataflows.size() >= _max_cached_dataflows)
+			{
+				worker.dataflows.clear();
+				worker.results.clear();
+			}
+			PEArray pe(worker.context);
+			Statement st(worker.context);
+			Mapping mp(worker.context);
+			istringstream pe_input(job.pe), st_input(job.statement), mp_input(job.mapping);
+			if (!pe.Load(pe_input) || !st.Load(st_input) || !mp.Load(mp_input))
+				return response + ", \"error\": \"invalid statement, mapping or pe\"}";
+			// the metrics see a single array, see Dataflow::GetDeviceDataflows
+			if (mp.HasDeviceMap())
+				return response + ", \"error\": \"device maps are not supported\"}";
+			iter = worker.dataflows.emplace(job.key,
+				make_unique<Dataflow>(move(st), move(pe), move(mp))).first;
+		}
+		Dataflow& df = *iter->second;
+
+		for (auto& metric : job.metrics)
+		{
+			string result_key = job.key + "|" + metric;
+			auto cached = worker.results.find(result_key);
+			double value = 0;
+			if (cached != worker.results.end())
+				value = cached->second;
+			else
+			{
+				bool valid;
+				value = evaluate(df, metric, valid);
+				if (!valid)
+					return response + ", \"error\": " + quote("unknown metric " + metric) + "}";
+				worker.results[result_key] = value;
+			}
+			char buf[64];
+			snprintf(buf, sizeof(buf), "%.17g", value);
+			response += ", " + quote(metric) + ": " + buf;
+		}
+		return response + "}";
+	}
+	catch (const exception& e)
+	{
+		return response + ", \"error\": " + quote(string("invalid request: ") + e.what()) + "}";
+	}
+}
+
+void
+AnalysisServer::Serve(FILE* in, FILE* out)
+{
+	mutex out_mutex;
+	condition_variable done;
+	unsigned pending = 0;
+	auto reply = [&](const string& line)
+	{
+		lock_guard<mutex> lock(out_mutex);
+		fprintf(out, "%s\n", line.c_str());
+		fflush(out);
+		pending--;
+		done.notify_all();
+	};
+
+	auto submit = [&](const string& line)
+	{
+		map<string, JsonValue> request;
+		if (line.find_first_not_of(" \t\r") == string::npos)
+			return;
+		Job job;
+		job.metrics = GetMetricNames();
+		bool valid = parse_object(line, request);
+		if (valid && request.count("id"))
+			job.request_id = request["id"].list.empty() && !request["id"].str.empty() ?
+				(isdigit((unsigned char)request["id"].str[0]) || request["id"].str[0] == '-' ?
+					request["id"].str : quote(request["id"].str)) : "null";
+		else
+			job.request_id = "null";
+		if (valid)
+			valid = resolve(request["statement"].str, job.statement) &&
+				resolve(request["mapping"].str, job.mapping) &&
+				resolve(request["pe"].str, job.pe);
+		if (!valid)
+		{
+			lock_guard<mutex> lock(out_mutex);
+			fprintf(out, "{\"id\": %s, \"error\": \"invalid request\"}\n", job.request_id.c_str());
+			fflush(out);
+			return;
+		}
+		if (!request["metrics"].list.empty())
+			job.metrics = request["metrics"].list;
+		job.key = job.statement + '\0' + job.mapping + '\0' + job.pe;
+		job.reply = reply;
+
+		// the same inputs always go to the same worker to hit its caches
+		Worker& worker = *_workers[hash<string>()(job.key) % _workers.size()];
+		{
+			lock_guard<mutex> lock(out_mutex);
+			pending++;
+		}
+		{
+			lock_guard<mutex> lock(worker.mutex);
+			worker.jobs.push_back(move(job));
+		}
+		worker.ready.notify_one();
+	};
+
+	string line;
+	for (int c = fgetc(in); c != EOF; c = fgetc(in))
+	{
+		if (c != '\n')
+		{
+			line += (char)c;
+			continue;
+		}
+		submit(line);
+		line.clear();
+	}
+	// the last request may not end with a newline
+	submit(line);
+	unique_lock<mutex> lock(out_mutex);
+	done.wait(lock, [&] { return pending == 0; });
+}
+
+bool
+AnalysisServer::ServeSocket(const char* socket_path)
+{
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0)
+	{
+		fprintf(stderr, "Create socket failed\n");
+		return false;
+	}
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	unlink(socket_path);
+	if (bind(server, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(server, 8) < 0)
+	{
+		fprintf(stderr, "Listen on %s failed\n", socket_path);
+		close(server);
+		return false;
+	}
+	while (true)
+	{
+		int client = accept(server, NULL, NULL);
+		if (client < 0)
+			continue;
+		// a client that keeps its connection open does not block the others,
+		// all connections share the workers and their caches
+		thread([this, client] {
+			FILE* in = fdopen(client, "r");
+			FILE* out = fdopen(dup(client), "w");
+			Serve(in, out);
+			fclose(in);
+			fclose(out);
+		}).detach();
+	}
+}
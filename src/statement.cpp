@@ -1,8 +1,221 @@
 #include"statement.h"
+#include<cerrno>
+#include<climits>
 
 using namespace std;
 using namespace TENET;
 
+namespace
+{
+
+string join(const vector<string>& strs, const char* sep)
+{
+	string ret;
+	for (auto& s : strs)
+		ret += (ret.empty() ? "" : sep) + s;
+	return ret;
+}
+
+template<class Obj, class SetName>
+Obj *rename_dims(Obj *obj, SetName set_name, int n, enum isl_dim_type type, const char* prefix)
+{
+	for (int i = 0; i < n; i++)
+		obj = set_name(obj, type, i, (prefix + to_string(i)).c_str());
+	return obj;
+}
+
+isl_stat canonical_set(isl_set *set, void *user)
+{
+	set = isl_set_set_tuple_name(set, "S");
+	set = rename_dims(set, isl_set_set_dim_name, isl_set_dim(set, isl_dim_param), isl_dim_param, "p");
+	set = rename_dims(set, isl_set_set_dim_name, isl_set_dim(set, isl_dim_set), isl_dim_set, "i");
+	set = isl_set_coalesce(isl_set_detect_equalities(set));
+	char *str = isl_set_to_str(set);
+	static_cast<vector<string>*>(user)->push_back(str);
+	free(str);
+	isl_set_free(set);
+	return isl_stat_ok;
+}
+
+isl_stat canonical_map(isl_map *map, void *user)
+{
+	map = isl_map_set_tuple_name(map, isl_dim_in, "S");
+	map = isl_map_set_tuple_name(map, isl_dim_out, "T");
+	map = rename_dims(map, isl_map_set_dim_name, isl_map_dim(map, isl_dim_param), isl_dim_param, "p");
+	map = rename_dims(map, isl_map_set_dim_name, isl_map_dim(map, isl_dim_in), isl_dim_in, "i");
+	map = rename_dims(map, isl_map_set_dim_name, isl_map_dim(map, isl_dim_out), isl_dim_out, "o");
+	map = isl_map_coalesce(isl_map_detect_equalities(map));
+	char *str = isl_map_to_str(map);
+	static_cast<vector<string>*>(user)->push_back(str);
+	free(str);
+	isl_map_free(map);
+	return isl_stat_ok;
+}
+
+// the whole of str as a finite number
+bool parse_number(const string& str, double& value)
+{
+	char *end = NULL;
+	errno = 0;
+	value = strtod(str.c_str(), &end);
+	return !str.empty() && *end == '\0' && errno == 0 && isfinite(value);
+}
+
+// the whole of str as a positive int
+bool parse_positive(const string& str, unsigned& value)
+{
+	char *end = NULL;
+	errno = 0;
+	long v = strtol(str.c_str(), &end, 10);
+	if (str.empty() || *end != '\0' || errno != 0 || v <= 0 || v > INT_MAX)
+		return false;
+	value = v;
+	return true;
+}
+
+// split an access line into the access relation and its annotations,
+// e.g. "{S[i,k]->W[k]} bits=8 compression=0.5 density=uniform(0.1)"
+bool parse_access(
+	const string& line,
+	string& access_str,
+	unsigned& bits,
+	double& compression,
+	Sparsity& sparsity)
+{
+	size_t end = line.rfind('}');
+	if (end == string::npos)
+		return false;
+	access_str = line.substr(0, end + 1);
+	istringstream options(line.substr(end + 1));
+	string option;
+	while (options >> option)
+	{
+		size_t pos = option.find('=');
+		string key = option.substr(0, pos);
+		if (pos == string::npos)
+			return false;
+		if (key == "bits")
+		{
+			if (!parse_positive(option.substr(pos + 1), bits))
+				return false;
+		}
+		else if (key == "compression")
+		{
+			if (!parse_number(option.substr(pos + 1), compression) || compression <= 0)
+				return false;
+		}
+		else if (key == "density")
+		{
+			if (!sparsity.Parse(option.substr(pos + 1)))
+				return false;
+		}
+		else
+			return false;
+	}
+	return true;
+}
+
+// annotations of an access line as read by parse_access
+string access_options(const Access& ac)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), " bits=%u compression=%.17g", ac.GetBits(), ac.GetCompression());
+	string ret = buf;
+	if (ac.GetSparsity().model != Sparsity::Model::DENSE)
+		ret += " density=" + ac.GetSparsity().ToString();
+	return ret;
+}
+
+} // namespace
+
+bool
+Sparsity::Parse(const string& str)
+{
+	size_t open = str.find('('), close = str.rfind(')');
+	if (open == string::npos || close == string::npos || close < open)
+		return false;
+	string name = str.substr(0, open);
+	if (name == "uniform")
+		model = Model::UNIFORM;
+	else if (name == "block")
+		model = Model::BLOCK;
+	else if (name == "csf")
+		model = Model::CSF;
+	else
+		return false;
+	params.clear();
+	string values = str.substr(open + 1, close - open - 1);
+	double param = 0;
+	for (size_t begin = 0, end = 0; end != string::npos; begin = end + 1)
+	{
+		end = values.find(',', begin);
+		if (!parse_number(values.substr(begin, end == string::npos ? string::npos : end - begin), param))
+			return false;
+		params.push_back(param);
+	}
+	if (params.empty() || (model == Model::UNIFORM && params.size() != 1))
+		return false;
+	for (unsigned i = 0; i < params.size(); i++)
+	{
+		// block sizes follow the density of block()
+		if (model == Model::BLOCK && i > 0)
+		{
+			if (params[i] < 1)
+				return false;
+		}
+		else if (params[i] <= 0 || params[i] > 1)
+			return false;
+	}
+	return true;
+}
+
+string
+Sparsity::ToString() const
+{
+	const char* names[] = {"", "uniform", "block", "csf"};
+	if (model == Model::DENSE)
+		return "";
+	vector<string> values;
+	char buf[32];
+	for (double p : params)
+	{
+		snprintf(buf, sizeof(buf), "%.17g", p);
+		values.push_back(buf);
+	}
+	return names[(int)model] + ("(" + join(values, ",") + ")");
+}
+
+double
+Sparsity::GetDensity() const
+{
+	switch (model)
+	{
+	case Model::UNIFORM:
+	case Model::BLOCK:
+		// every element of a nonzero block is stored
+		return params[0];
+	case Model::CSF:
+	{
+		double density = 1;
+		for (double d : params)
+			density *= d;
+		return density;
+	}
+	default:
+		return 1;
+	}
+}
+
+vector<unsigned>
+Sparsity::GetBlockShape() const
+{
+	vector<unsigned> shape;
+	if (model == Model::BLOCK)
+		for (unsigned i = 1; i < params.size(); i++)
+			shape.push_back(max(1L, lround(params[i])));
+	return shape;
+}
+
 Access::Access(shared_ptr<ISL_Context> context)
 	:_context(context)
 {}
@@ -23,6 +236,10 @@ Access::PrintInfo() const
 	_context->printf("Tensor Name: %s\n", _tensor_name.c_str());
 	const char* access_type = _is_write ? "write" : "read";
 	_context->printf("Access Type: %s\n", access_type);
+	if (_bits != BIT_PER_ITEM || _compression != 1.0)
+		_context->printf("Bits: %u Compression: %.3f\n", _bits, _compression);
+	if (_sparsity.model != Sparsity::Model::DENSE)
+		_context->printf("Density: %.4f\n", _sparsity.GetDensity());
 	_context->printf("Access: ");
 	_context->printer(isl_printer_print_union_map, _access.get());
 	_context->printf("\n\n");
@@ -37,6 +254,9 @@ Access::copy() const
 		isl_union_map_copy(_access.get())
 	);
 	result._is_write = _is_write;
+	result._bits = _bits;
+	result._compression = _compression;
+	result._sparsity = _sparsity;
 	return result;
 }
 
@@ -71,49 +291,76 @@ Statement::Load(const char* filename)
 	ifstream input(filename);
 	if (!input.is_open())
 		return false;
+	return Load(input);
+}
+
+bool
+Statement::Load(istream& input)
+{
 	string domain_str, access_str;
-	int read_num, write_num;
-	input >> read_num >> write_num;
+	int read_num = 0, write_num = 0;
+	if (!(input >> read_num >> write_num))
+		return false;
 	getline(input, domain_str);
 	getline(input, domain_str);
 
 	_domain.reset(
 		isl_union_set_read_from_str(_context->ctx(), domain_str.c_str())
 	);
+	if (!_domain)
+		return false;
 	_read.clear();
 	_write.clear();
 
-	for (int i = 0; i < read_num; i++)
-	{
-		getline(input, access_str);
-		size_t pos = access_str.rfind("->");
-		pos = pos + 2;
-		size_t len = 0;
-		while (access_str[pos + len] != '[')
-			len++;
-		string tensor_name = access_str.substr(pos, len);
-		this->AddAccess(
-			Access{_context, tensor_name, access_str.c_str(), false}
-		);
-	}
-
-	for (int i = 0; i < write_num; i++)
+	for (int i = 0; i < read_num + write_num; i++)
 	{
-		getline(input, access_str);
+		string line;
+		getline(input, line);
+		unsigned bits = BIT_PER_ITEM;
+		double compression = 1.0;
+		Sparsity sparsity;
+		if (!parse_access(line, access_str, bits, compression, sparsity))
+		{
+			fprintf(stderr, "Invalid access %s\n", line.c_str());
+			return false;
+		}
 		size_t pos = access_str.rfind("->");
-		pos = pos + 2;
-		size_t len = 0;
-		while (access_str[pos + len] != '[')
-			len++;
-		string tensor_name = access_str.substr(pos, len);
-		this->AddAccess(
-			Access{_context, tensor_name, access_str.c_str(), true}
-		);
+		size_t end = pos == string::npos ? string::npos : access_str.find('[', pos);
+		if (end == string::npos)
+		{
+			fprintf(stderr, "Invalid access %s\n", line.c_str());
+			return false;
+		}
+		// isl prints a space after the arrow
+		pos = access_str.find_first_not_of(" ", pos + 2);
+		string tensor_name = access_str.substr(pos, end - pos);
+		Access ac{_context, tensor_name, access_str.c_str(), i >= read_num};
+		if (!ac._access)
+			return false;
+		ac.SetBits(bits, compression);
+		ac.SetSparsity(sparsity);
+		this->AddAccess(move(ac));
 	}
-	input.close();
 	return true;
 }
 
+string
+Statement::Serialize() const
+{
+	ostringstream out;
+	out << _read.size() << " " << _write.size() << "\n" << ToString(_domain.get()) << "\n";
+	for (auto accesses : {&_read, &_write})
+		for (auto& ac : *accesses)
+			out << ToString(ac._access.get()) << access_options(ac) << "\n";
+	return out.str();
+}
+
+void
+Statement::IntersectDomain(isl_union_set *instances)
+{
+	_domain.reset(isl_union_set_intersect(_domain.release(), instances));
+}
+
 isl_union_map*
 Statement::GetAccess(
 	string tensor_name,
@@ -146,6 +393,44 @@ Statement::GetAccess(
 	return ret;
 }
 
+double
+Statement::GetBitsPerItem(string tensor_name, AccessType type) const
+{
+	if (type == AccessType::READ || type == AccessType::READ_OR_WRITE)
+		for (auto& ac : _read)
+			if (ac._tensor_name == tensor_name)
+				return ac._bits * ac._compression;
+	if (type == AccessType::WRITE || type == AccessType::READ_OR_WRITE)
+		for (auto& ac : _write)
+			if (ac._tensor_name == tensor_name)
+				return ac._bits * ac._compression;
+	return BIT_PER_ITEM;
+}
+
+double
+Statement::GetDensity(string tensor_name) const
+{
+	for (auto& ac : _read)
+		if (ac._tensor_name == tensor_name)
+			return ac._sparsity.GetDensity();
+	for (auto& ac : _write)
+		if (ac._tensor_name == tensor_name)
+			return ac._sparsity.GetDensity();
+	return 1;
+}
+
+vector<unsigned>
+Statement::GetBlockShape(string tensor_name) const
+{
+	for (auto& ac : _read)
+		if (ac._tensor_name == tensor_name)
+			return ac._sparsity.GetBlockShape();
+	for (auto& ac : _write)
+		if (ac._tensor_name == tensor_name)
+			return ac._sparsity.GetBlockShape();
+	return {};
+}
+
 void
 Statement::PrintInfo() const
 {
@@ -177,10 +462,50 @@ Statement::GetTensorList() const
 	return make_pair(input, output);
 }
 
+string
+Statement::GetCanonicalKey() const
+{
+	vector<string> domain_strs;
+	isl_union_set *domain = GetDomain();
+	isl_union_set_foreach_set(domain, canonical_set, &domain_strs);
+	isl_union_set_free(domain);
+	sort(domain_strs.begin(), domain_strs.end());
+
+	// tensors are identified by the sorted list of their accesses and their
+	// annotations, so the key does not depend on tensor names or declaration order
+	map<string, vector<string>> tensors;
+	auto add_access = [&](const Access& ac, const char* type)
+	{
+		vector<string> strs;
+		isl_union_map *access = isl_union_map_intersect_domain(ac.GetAccess(), GetDomain());
+		isl_union_map_foreach_map(access, canonical_map, &strs);
+		isl_union_map_free(access);
+		for (auto& str : strs)
+			tensors[ac._tensor_name].push_back(type + str + access_options(ac));
+	};
+	for (auto& ac : _read)
+		add_access(ac, "R");
+	for (auto& ac : _write)
+		add_access(ac, "W");
+
+	vector<string> signatures;
+	for (auto& [name, strs] : tensors)
+	{
+		sort(strs.begin(), strs.end());
+		signatures.push_back(join(strs, ";"));
+	}
+	sort(signatures.begin(), signatures.end());
+	return join(domain_strs, ";") + "|" + join(signatures, "|");
+}
+
 Statement
 Statement::copy() const
 {
 	Statement result{_context};
 	result._domain.reset(isl_union_set_copy(_domain.get()));
+	for (auto& ac : _read)
+		result._read.push_back(ac.copy());
+	for (auto& ac : _write)
+		result._write.push_back(ac.copy());
 	return result;
 }
@@ -5,6 +5,83 @@ using namespace std;
 
 using namespace TENET;
 
+namespace
+{
+
+struct EvaluateArgs
+{
+  const vector<isl_union_pw_qpolynomial*> *fns;
+  vector<PointValue> *points;
+};
+
+isl_stat evaluate_point(isl_point *pnt, void *user)
+{
+  auto args = static_cast<EvaluateArgs*>(user);
+  PointValue point;
+  isl_space *space = isl_point_get_space(pnt);
+  int n = isl_space_dim(space, isl_dim_set);
+  isl_space_free(space);
+  for (int i = 0; i < n; i++)
+  {
+    isl_val *v = isl_point_get_coordinate_val(pnt, isl_dim_set, i);
+    point.coords.push_back(isl_val_get_num_si(v));
+    isl_val_free(v);
+  }
+  for (auto fn : *args->fns)
+  {
+    isl_val *v = isl_union_pw_qpolynomial_eval(
+      isl_union_pw_qpolynomial_copy(fn), isl_point_copy(pnt));
+    point.values.push_back(isl_val_is_nan(v) ? 0 : isl_val_get_d(v));
+    isl_val_free(v);
+  }
+  isl_point_free(pnt);
+  args->points->push_back(move(point));
+  return isl_stat_ok;
+}
+
+// the bound of a fold printed as "{ max(a, b) : ...; max(c) : ... }" is the
+// max (or min) of the candidates of all pieces, which are constants "a" or
+// "a/b". Candidates that are not constants are skipped.
+double parse_fold(const char *s)
+{
+  bool found = false;
+  double ret = 0;
+  for (const char *p = s; *p != '\0'; )
+  {
+    bool is_max = strncmp(p, "max(", 4) == 0;
+    if (!is_max && strncmp(p, "min(", 4) != 0)
+    {
+      p++;
+      continue;
+    }
+    for (p += 4; *p != '\0' && *p != ')'; )
+    {
+      char *end;
+      double value = strtod(p, &end);
+      bool is_value = end != p;
+      if (is_value && *end == '/')
+      {
+        const char *den_str = end + 1;
+        double den = strtod(den_str, &end);
+        is_value = end != den_str && den != 0;
+        value /= den;
+      }
+      end += strspn(end, " ");
+      if (is_value && (*end == ',' || *end == ')'))
+      {
+        ret = !found ? value : (is_max ? max(ret, value) : min(ret, value));
+        found = true;
+      }
+      p = end + strcspn(end, ",)");
+      if (*p == ',')
+        p++;
+    }
+  }
+  return ret;
+}
+
+} // namespace
+
 ISL_Context::ISL_Context(FILE* file) :
     _ctx(isl_ctx_alloc()),
     _p(isl_printer_set_output_format(
@@ -38,3 +115,76 @@ ISL_Context::~ISL_Context()
 {
   isl_printer_free(_p);
 }
+
+// this function is used to convert a union piecewise quasi-polynomial function that
+// HAVE A EMPTY DOMAIN (that is, only have a value) to int 
+// upwqp is freed by this function.
+double
+TENET::convert_upwqp_to_int(isl_union_pw_qpolynomial *upwqp)
+{
+  // NULL after a failed or aborted ISL operation
+  if (upwqp == NULL)
+    return 0;
+  isl_printer *p = isl_printer_to_str(isl_union_pw_qpolynomial_get_ctx(upwqp));
+  p = isl_printer_set_output_format(p, ISL_FORMAT_ISL);
+  p = isl_printer_print_union_pw_qpolynomial(p, upwqp);
+  char *s = isl_printer_get_str(p);
+  // counts beyond the range of int are common on large layers
+  double ret = s == NULL ? 0 : atof(s + 1);
+  free(s);
+  isl_union_pw_qpolynomial_free(upwqp);
+  isl_printer_free(p);
+  return ret;
+}
+
+// the bound is printed as "{ max(a, b) }", possibly in several pieces,
+// or "{ }" when the domain is empty
+double
+TENET::convert_upwqpf_to_int(isl_union_pw_qpolynomial_fold *upwqpf)
+{
+  if (upwqpf == NULL)
+    return 0;
+  isl_printer *p = isl_printer_to_str(isl_union_pw_qpolynomial_fold_get_ctx(upwqpf));
+  p = isl_printer_set_output_format(p, ISL_FORMAT_ISL);
+  p = isl_printer_print_union_pw_qpolynomial_fold(p, upwqpf);
+  char *s = isl_printer_get_str(p);
+  double ret = s == NULL ? 0 : parse_fold(s);
+  free(s);
+  isl_union_pw_qpolynomial_fold_free(upwqpf);
+  isl_printer_free(p);
+  return ret;
+}
+
+string
+TENET::ToString(isl_union_set *uset)
+{
+  char *s = isl_union_set_to_str(uset);
+  string ret = s == NULL ? "" : s;
+  free(s);
+  return ret;
+}
+
+string
+TENET::ToString(isl_union_map *umap)
+{
+  char *s = isl_union_map_to_str(umap);
+  string ret = s == NULL ? "" : s;
+  free(s);
+  return ret;
+}
+
+vector<PointValue>
+TENET::EvaluateOnPoints(
+  isl_union_set *domain,
+  vector<isl_union_pw_qpolynomial*> fns)
+{
+  vector<PointValue> points;
+  EvaluateArgs args{&fns, &points};
+  isl_union_set_foreach_point(domain, evaluate_point, &args);
+  isl_union_set_free(domain);
+  for (auto fn : fns)
+    isl_union_pw_qpolynomial_free(fn);
+  sort(points.begin(), points.end(),
+    [](auto &a, auto &b) { return a.coords < b.coords; });
+  return points;
+}
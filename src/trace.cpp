@@ -0,0 +1,253 @@
+#include "trace.h"
+
+using namespace std;
+using namespace TENET;
+
+namespace
+{
+
+const char trace_magic[4] = {'T', 'N', 'T', 'R'};
+const unsigned trace_version = 1;
+const unsigned long time_tag = 0;
+const unsigned long pe_tag = 1;
+const unsigned long access_tag = 2;
+
+class TraceBuffer
+{
+public:
+	TraceBuffer(FILE* file): _file(file) {}
+	~TraceBuffer()
+	{Flush();}
+
+	void Put(unsigned long value)
+	{
+		while (value >= 0x80)
+		{
+			_data.push_back((unsigned char)(value | 0x80));
+			value >>= 7;
+		}
+		_data.push_back((unsigned char)value);
+		if (_data.size() >= (1 << 20))
+			Flush();
+	}
+
+	void PutDeltas(const vector<long>& values, vector<long>& prev)
+	{
+		for (unsigned i = 0; i < values.size(); i++)
+		{
+			long delta = values[i] - prev[i];
+			Put(((unsigned long)delta << 1) ^ (unsigned long)(delta >> 63)); // zigzag
+			prev[i] = values[i];
+		}
+	}
+
+	void PutString(const string& str)
+	{
+		Put(str.size());
+		_data.insert(_data.end(), str.begin(), str.end());
+	}
+
+	// false once a write has failed, e.g. on a full disk
+	bool Flush()
+	{
+		if (fwrite(_data.data(), 1, _data.size(), _file) != _data.size())
+			_failed = true;
+		_data.clear();
+		return !_failed && !ferror(_file);
+	}
+
+	bool Good() const
+	{return !_failed && !ferror(_file);}
+
+private:
+	FILE* _file;
+	vector<unsigned char> _data;
+	bool _failed{false};
+};
+
+isl_stat get_dim(isl_set *set, void *user)
+{
+	*static_cast<unsigned*>(user) = isl_set_dim(set, isl_dim_set);
+	isl_set_free(set);
+	return isl_stat_ok;
+}
+
+// dims of the sets in uset, which all have the same dims
+unsigned dims_of(isl_union_set *uset)
+{
+	unsigned n = 0;
+	isl_union_set_foreach_set(uset, get_dim, &n);
+	isl_union_set_free(uset);
+	return n;
+}
+
+} // namespace
+
+bool
+TENET::WriteTrace(Dataflow& df, const char* filename, unsigned slice_dims)
+{
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+		return false;
+	TraceHeader header;
+	header.pe_dims = dims_of(df.GetSpaceDomain());
+	header.time_dims = dims_of(df.GetTimeDomain());
+	// the order of StreamAccesses: inputs, then outputs
+	auto [input, output] = df.GetTensorList();
+	for (auto [tensors, type] : {make_pair(input, AccessType::READ), make_pair(output, AccessType::WRITE)})
+		for (auto& tensor : tensors)
+			header.tensors.push_back(TraceTensor{tensor, type,
+				dims_of(isl_union_map_range(df.GetAccess(tensor, type)))});
+
+	bool written = fwrite(trace_magic, 1, sizeof(trace_magic), file) == sizeof(trace_magic);
+	{
+		TraceBuffer out(file);
+		out.Put(trace_version);
+		out.Put(header.pe_dims);
+		out.Put(header.time_dims);
+		out.Put(header.tensors.size());
+		for (auto& tensor : header.tensors)
+		{
+			out.PutString(tensor.name);
+			out.Put(tensor.type == AccessType::WRITE ? 1 : 0);
+			out.Put(tensor.dims);
+		}
+
+		vector<long> time(header.time_dims, 0), pe(header.pe_dims, 0);
+		vector<vector<long>> elements;
+		for (auto& tensor : header.tensors)
+			elements.emplace_back(tensor.dims, 0);
+		bool first = true, new_time = false;
+		df.StreamAccesses("", AccessType::READ_OR_WRITE, slice_dims, [&](const AccessEvent& event)
+		{
+			if (first || event.time != time)
+			{
+				out.Put(time_tag);
+				out.PutDeltas(event.time, time);
+				new_time = true;
+			}
+			if (new_time || event.pe != pe)
+			{
+				out.Put(pe_tag);
+				out.PutDeltas(event.pe, pe);
+			}
+			first = new_time = false;
+			out.Put(access_tag + event.tensor_id);
+			out.PutDeltas(event.element, elements[event.tensor_id]);
+			return out.Good();
+		});
+		written = out.Flush() && written;
+	}
+	written = !ferror(file) && written;
+	if (!written)
+		fprintf(stderr, "Failed to write the trace to %s\n", filename);
+	return fclose(file) == 0 && written;
+}
+
+TraceReader::~TraceReader()
+{
+	if (_file)
+		fclose(_file);
+}
+
+bool
+TraceReader::read_varint(unsigned long& value)
+{
+	value = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7)
+	{
+		int c = fgetc(_file);
+		if (c == EOF)
+			return false;
+		value |= (unsigned long)(c & 0x7f) << shift;
+		if ((c & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+bool
+TraceReader::read_deltas(vector<long>& values)
+{
+	for (auto& v : values)
+	{
+		unsigned long zigzag;
+		if (!read_varint(zigzag))
+			return false;
+		v += (long)(zigzag >> 1) ^ -(long)(zigzag & 1);
+	}
+	return true;
+}
+
+bool
+TraceReader::Open(const char* filename)
+{
+	if (_file)
+		fclose(_file);
+	_file = fopen(filename, "rb");
+	if (_file == NULL)
+		return false;
+	char magic[sizeof(trace_magic)];
+	unsigned long version, pe_dims, time_dims, tensor_num;
+	if (fread(magic, 1, sizeof(magic), _file) != sizeof(magic) ||
+		memcmp(magic, trace_magic, sizeof(magic)) != 0 ||
+		!read_varint(version) || version != trace_version ||
+		!read_varint(pe_dims) || !read_varint(time_dims) || !read_varint(tensor_num))
+	{
+		fprintf(stderr, "%s is not a TENET trace\n", filename);
+		return false;
+	}
+	_header = TraceHeader{(unsigned)pe_dims, (unsigned)time_dims, {}};
+	for (unsigned long i = 0; i < tensor_num; i++)
+	{
+		unsigned long length, type, dims;
+		if (!read_varint(length))
+			return false;
+		string name(length, ' ');
+		if (fread(&name[0], 1, length, _file) != length || !read_varint(type) || !read_varint(dims))
+			return false;
+		_header.tensors.push_back(TraceTensor{name, type ? AccessType::WRITE : AccessType::READ,
+			(unsigned)dims});
+	}
+	_time.assign(time_dims, 0);
+	_pe.assign(pe_dims, 0);
+	_elements.clear();
+	for (auto& tensor : _header.tensors)
+		_elements.emplace_back(tensor.dims, 0);
+	_time_stamp_num = 0;
+	return true;
+}
+
+bool
+TraceReader::Next(AccessEvent& event)
+{
+	unsigned long tag;
+	while (_file && read_varint(tag))
+	{
+		if (tag == time_tag)
+		{
+			if (!read_deltas(_time))
+				return false;
+			_time_stamp_num++;
+		}
+		else if (tag == pe_tag)
+		{
+			if (!read_deltas(_pe))
+				return false;
+		}
+		else
+		{
+			unsigned long id = tag - access_tag;
+			if (id >= _elements.size() || !read_deltas(_elements[id]))
+				return false;
+			event.time = _time;
+			event.pe = _pe;
+			event.tensor_id = id;
+			event.tensor = &_header.tensors[id].name;
+			event.type = _header.tensors[id].type;
+			event.element = _elements[id];
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,237 @@
+#include "tuner.h"
+#include "parallel.h"
+
+using namespace std;
+using namespace TENET;
+
+namespace
+{
+
+bool read_file(const char* filename, string& content)
+{
+	ifstream input(filename);
+	if (!input.is_open())
+		return false;
+	content.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+	return true;
+}
+
+string substitute(string str, unsigned x, unsigned y)
+{
+	for (auto [key, value] : {make_pair("$X", x), make_pair("$Y", y)})
+		for (size_t pos = str.find(key); pos != string::npos; pos = str.find(key, pos))
+			str.replace(pos, 2, to_string(value));
+	return str;
+}
+
+// fraction of a working set that fits in a buffer
+double fit(double working_set, double size)
+{
+	return working_set <= size ? 1 : size / working_set;
+}
+
+} // namespace
+
+bool
+HardwareConfig::Dominates(const HardwareConfig& other) const noexcept
+{
+	bool no_worse = delay <= other.delay && energy <= other.energy && area <= other.area;
+	bool better = delay < other.delay || energy < other.energy || area < other.area;
+	return no_worse && better;
+}
+
+bool
+Tuner::Load(const char* pe_template, const char* mapping_template)
+{
+	if (!read_file(pe_template, _pe_template) || !read_file(mapping_template, _mapping_template))
+		return false;
+	// the templates must load for some shape, the sizes are those of any shape
+	shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+	PEArray pe(context);
+	Mapping mp(context);
+	if (!load(context, 1, 1, pe, mp))
+		return false;
+	_l1size = pe.GetL1Size();
+	_l2size = pe.GetL2Size();
+	_bandwidth = pe.GetBandwidth();
+	return true;
+}
+
+bool
+Tuner::load(shared_ptr<ISL_Context> context, unsigned x, unsigned y, PEArray& pe, Mapping& mp) const
+{
+	istringstream pe_input(substitute(_pe_template, x, y));
+	istringstream mapping_input(substitute(_mapping_template, x, y));
+	if (!pe.Load(pe_input) || !mp.Load(mapping_input))
+	{
+		fprintf(stderr, "PE array or mapping template does not load for %ux%u\n", x, y);
+		return false;
+	}
+	// the cost model sees a single array
+	if (mp.HasDeviceMap())
+	{
+		fprintf(stderr, "Mapping template has a device map\n");
+		return false;
+	}
+	return true;
+}
+
+bool
+Tuner::AddStatement(const char* statement_file)
+{
+	shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+	Statement st(context);
+	if (!st.Load(statement_file))
+		return false;
+	string filename = statement_file;
+	_workloads.push_back([filename](shared_ptr<ISL_Context> context)
+	{
+		Statement st(context);
+		st.Load(filename.c_str());
+		return st;
+	});
+	return true;
+}
+
+void
+Tuner::AddNetwork(const Network& network)
+{
+	auto& layers = network.GetLayers();
+	for (unsigned i = 0; i < layers.size(); i++)
+	{
+		if (layers[i].type != LayerType::CONV2D || layers[i].ox == 0 || layers[i].oy == 0)
+			continue;
+		_workloads.push_back([&network, i](shared_ptr<ISL_Context> context)
+			{ return network.GetStatement(context, i); });
+	}
+}
+
+bool
+Tuner::analyze(
+	shared_ptr<ISL_Context> context,
+	unsigned x,
+	unsigned y,
+	vector<Cost>& costs,
+	unsigned& avg_latency) const
+{
+	costs.clear();
+	for (auto& workload : _workloads)
+	{
+		PEArray pe(context);
+		Mapping mp(context);
+		if (!load(context, x, y, pe, mp))
+			return false;
+		avg_latency = pe.GetAvgLatency();
+		Dataflow df(workload(context), move(pe), move(mp));
+		isl_union_map *space_time_to_neighbor = df.MapSpaceTimeToNeighbor();
+
+		Cost cost;
+		cost.compute_delay = df.GetComputationDelay();
+		auto [input, output] = df.GetTensorList();
+		for (auto& tensor : input)
+		{
+			double bits = df.GetBitsPerItem(tensor, AccessType::READ);
+			cost.ingress_bits += bits * df.GetUniqueVolume(tensor, AccessType::READ,
+				isl_union_map_copy(space_time_to_neighbor));
+			cost.spatial_ingress_bits += bits * df.GetUniqueVolume(tensor, AccessType::READ,
+				df.MapSpaceTimeToNeighbor(1, true, 0, true, false));
+			cost.footprint_bits += bits * df.GetFootprint(tensor, AccessType::READ);
+		}
+		for (auto& tensor : output)
+		{
+			double bits = df.GetBitsPerItem(tensor, AccessType::WRITE);
+			cost.egress_bits += bits * df.GetUniqueVolume(tensor, AccessType::WRITE,
+				isl_union_map_copy(space_time_to_neighbor));
+			cost.footprint_bits += bits * df.GetFootprint(tensor, AccessType::WRITE);
+		}
+		cost.l1_working_set = df.GetL1WorkingSet("", AccessType::READ_OR_WRITE);
+		cost.l2_working_set = df.GetL2WorkingSet("", AccessType::READ_OR_WRITE);
+		cost.energy = df.GetEnergy(space_time_to_neighbor);
+		costs.push_back(cost);
+	}
+	return true;
+}
+
+vector<HardwareConfig>
+Tuner::Search(const HardwareBudget& budget, const TunerSpace& space, unsigned num_threads) const
+{
+	vector<unsigned> dims = space.dims;
+	if (dims.empty())
+		for (unsigned d = 2; d <= budget.max_pe; d *= 2)
+			dims.push_back(d);
+	// sizes that are not searched keep the values of the PE array template
+	vector<unsigned> l1_sizes = space.l1_sizes, l2_sizes = space.l2_sizes,
+		bandwidths = space.bandwidths;
+	if (l1_sizes.empty())
+		l1_sizes.push_back(_l1size);
+	if (l2_sizes.empty())
+		l2_sizes.push_back(_l2size);
+	if (bandwidths.empty())
+		bandwidths.push_back(_bandwidth);
+	vector<pair<unsigned, unsigned>> shapes;
+	for (unsigned x : dims)
+		for (unsigned y : dims)
+			if (x * y <= budget.max_pe)
+				shapes.emplace_back(x, y);
+
+	// every worker owns an isl_ctx, nothing ISL is shared between threads
+	num_threads = GetThreadNum(num_threads, shapes.size());
+	vector<shared_ptr<ISL_Context>> contexts(num_threads);
+	vector<vector<HardwareConfig>> results(shapes.size());
+	ParallelFor(shapes.size(), num_threads, [&](unsigned worker, unsigned job)
+	{
+		if (!contexts[worker])
+			contexts[worker] = make_shared<ISL_Context>(stdout);
+		auto [x, y] = shapes[job];
+		vector<Cost> costs;
+		unsigned avg_latency = 1;
+		if (!analyze(contexts[worker], x, y, costs, avg_latency))
+			return;
+
+		for (unsigned l1size : l1_sizes)
+		for (unsigned l2size : l2_sizes)
+		for (unsigned bandwidth : bandwidths)
+		{
+			if ((double)x * y * l1size + l2size > budget.max_sram)
+				continue;
+			HardwareConfig config{x, y, l1size, l2size, bandwidth};
+			for (auto& cost : costs)
+			{
+				double ingress_bits = cost.ingress_bits + (cost.spatial_ingress_bits -
+					cost.ingress_bits) * (1 - fit(cost.l1_working_set, l1size));
+				double l2_traffic = ingress_bits + cost.egress_bits;
+				double dram_bits = cost.footprint_bits + max(0.0, l2_traffic - cost.footprint_bits) *
+					(1 - fit(cost.l2_working_set, l2size));
+				double ingress_delay = transfer_delay(ingress_bits, bandwidth, avg_latency);
+				double egress_delay = transfer_delay(cost.egress_bits, bandwidth, avg_latency);
+				double dram_delay = dram_bits / space.dram_bandwidth;
+				config.delay += max(max(ingress_delay, egress_delay),
+					max(cost.compute_delay, dram_delay));
+				config.energy += cost.energy +
+					(l2_multiplier * (ingress_bits - cost.ingress_bits) +
+					dram_multiplier * dram_bits) / BIT_PER_ITEM;
+			}
+			config.area = x * y * (1 + l1size * sram_area_per_item) +
+				l2size * sram_area_per_item + bandwidth * bandwidth_area_per_bit;
+			results[job].push_back(config);
+		}
+	});
+
+	vector<HardwareConfig> ret;
+	for (auto& result : results)
+		ret.insert(ret.end(), result.begin(), result.end());
+	return ret;
+}
+
+vector<HardwareConfig>
+Tuner::GetFrontier(const vector<HardwareConfig>& configs)
+{
+	vector<HardwareConfig> frontier;
+	for (auto& config : configs)
+		if (none_of(configs.begin(), configs.end(),
+			[&](auto& other) { return other.Dominates(config); }))
+			frontier.push_back(config);
+	sort(frontier.begin(), frontier.end(),
+		[](auto& a, auto& b) { return a.delay < b.delay; });
+	return frontier;
+}
@@ -1,4 +1,5 @@
 #include"dataflow.h"
+#include "context_manager.h"
 #include "config.h"
 #include <ctime>
 #include <filesystem>
@@ -11,36 +12,11 @@ using path = filesystem::path;
 #define Test_Switch 0
 #define VERBOSE 1 
 
-void DataflowAnalysis(
-	shared_ptr<ISL_Context> context,
-	const char* _pe_file,
-	const char* _statement_file,
-	const char* _mapping_file)
+void ArrayAnalysis(
+	Dataflow& df,
+	const vector<string>& input,
+	const vector<string>& output)
 {
-	PEArray pe(context);
-	if (!pe.Load(_pe_file))
-	{
-		fprintf(stderr, "Load PE %s failed\n", _pe_file);
-		return;
-	}
-	else{
-	//pe.PrintInfo();
-	}
-	Statement st(context);
-	if (!st.Load(_statement_file))
-	{
-		fprintf(stderr, "Load Statement %s failed\n", _statement_file);
-		return;
-	}
-	Mapping mp(context);
-	if (!mp.Load(_mapping_file))
-	{
-		fprintf(stderr, "Load Mapping %s failed\n", _mapping_file);
-		return;
-	}
-	auto [input, output] = st.GetTensorList();
-	Dataflow df(move(st), move(pe), move(mp)); // st, pe and mp is moved into df, DONT USE THEM AGAIN!
-
 	//df.PrintInfo();
 	isl_union_map *space_time_to_neighbor = df.MapSpaceTimeToNeighbor();
 
@@ -88,16 +64,75 @@ void DataflowAnalysis(
 	int computation_delay = df.GetComputationDelay();
 	fprintf(stdout, "Delay: In: %d; Out: %d; Com: %d\n", ingress_delay, egress_delay, computation_delay);
 
+	Reduction reduction = df.GetReduction();
+	fprintf(stdout, "Reduction: Depth: %u; Egress: %.0f; Delay: %.0f\n", reduction.depth,
+		reduction.egress_volume, df.GetReductionEgressDelay());
+
 	int dsize = df.GetActivePENum();
 	double avg_dsize = df.GetAverageActivePENum();
 	fprintf(stdout, "Active PE Num: %d; Average: %.2f\n", dsize, avg_dsize);
 
+	double mac_num = df.GetMacNum(), expected_mac_num = df.GetExpectedMacNum();
+	if (expected_mac_num != mac_num)
+		fprintf(stdout, "MAC: %.0f; Expected: %.0f\n", mac_num, expected_mac_num);
+
+	PEWorkload workload = df.GetPEWorkload();
+	fprintf(stdout, "MAC per PE: Max: %.0f; Min: %.0f; Average: %.2f\n",
+		workload.max, workload.min, workload.average);
+
 	int energy = df.GetEnergy(isl_union_map_copy(space_time_to_neighbor)); // new!
 	fprintf(stdout, "Energy: %d\n", energy); //new!
 	isl_union_map_free(space_time_to_neighbor);
 }
 
-int experiment(shared_ptr<ISL_Context> context, path experiment_file) {
+bool DataflowAnalysis(
+	shared_ptr<ISL_Context> context,
+	const char* _pe_file,
+	const char* _statement_file,
+	const char* _mapping_file)
+{
+	PEArray pe(context);
+	if (!pe.Load(_pe_file))
+	{
+		fprintf(stderr, "Load PE %s failed\n", _pe_file);
+		return false;
+	}
+	else{
+	//pe.PrintInfo();
+	}
+	Statement st(context);
+	if (!st.Load(_statement_file))
+	{
+		fprintf(stderr, "Load Statement %s failed\n", _statement_file);
+		return false;
+	}
+	Mapping mp(context);
+	if (!mp.Load(_mapping_file))
+	{
+		fprintf(stderr, "Load Mapping %s failed\n", _mapping_file);
+		return false;
+	}
+	auto [input, output] = st.GetTensorList();
+	Dataflow df(move(st), move(pe), move(mp)); // st, pe and mp is moved into df, DONT USE THEM AGAIN!
+
+	if (!df.HasDeviceMap())
+	{
+		ArrayAnalysis(df, input, output);
+		return true;
+	}
+	// the array metrics only see one device at a time
+	DeviceSplit split = df.GetDeviceSplit();
+	fprintf(stdout, "Devices: %u; Balance: %.2f\n", split.device_num, split.balance);
+	unsigned d = 0;
+	for (auto& device : df.GetDeviceDataflows())
+	{
+		fprintf(stdout, "Device %u\n", d++);
+		ArrayAnalysis(device, input, output);
+	}
+	return true;
+}
+
+bool experiment(shared_ptr<ISL_Context> context, path experiment_file) {
 	fprintf(stdout, "Experiment %s\n", experiment_file.filename().c_str());
 	string prefix = "data/";
 
@@ -107,11 +142,11 @@ int experiment(shared_ptr<ISL_Context> context, path experiment_file) {
 	if (!experiment.is_open())
 	{
 		fprintf(stdout, "Experiment file %s fail to open\n", experiment_file.c_str());
-		return 0;
+		return false;
 	}
 
 	experiment >> mapping >> pe_array >> statement;
-	DataflowAnalysis(
+	bool ok = DataflowAnalysis(
 		context,
 		(prefix+pe_array).c_str(),
 		(prefix+statement).c_str(),
@@ -124,15 +159,51 @@ int experiment(shared_ptr<ISL_Context> context, path experiment_file) {
 	DataflowAnalysis((prefix+pe_array).c_str(),(prefix+statement).c_str(),(prefix+mapping).c_str());
 #endif
 	experiment.close();
-	fprintf(stdout, "\n");
-	return 0;
+	return ok;
 }
 
+/*
+	usage: bin/main [recycle=<experiments>] [recycle_mb=<MB>] [cap_mb=<MB>]
+	The isl_ctx is replaced every <experiments> experiments or once the
+	process grew by recycle_mb under it; an experiment growing the process
+	by more than cap_mb is stopped and reported as failed.
+ */
 int main(int argc, char * argv[])
 {
-	shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+	ContextLimits limits;
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg.rfind("recycle=", 0) == 0)
+			limits.max_experiments = stoi(arg.substr(8));
+		else if (arg.rfind("recycle_mb=", 0) == 0)
+			limits.recycle_bytes = stoul(arg.substr(11)) << 20;
+		else if (arg.rfind("cap_mb=", 0) == 0)
+			limits.max_experiment_bytes = stoul(arg.substr(7)) << 20;
+		else
+		{
+			fprintf(stderr, "usage: %s [recycle=<experiments>] [recycle_mb=<MB>] [cap_mb=<MB>]\n", argv[0]);
+			return 1;
+		}
+	}
+	ContextManager contexts(stdout, limits);
+	unsigned experiment_num = 0, failed_num = 0;
 	auto dir = filesystem::directory_entry(path("./data") / EXPERIMENT_PREFIX / path("experiment"));
 	for (auto&f : filesystem::directory_iterator(dir))
-		experiment(context, f.path());
-	return 0;
+	{
+		ExperimentResult result = contexts.Run([&](shared_ptr<ISL_Context> context) {
+			return experiment(context, f.path());
+		});
+		experiment_num++;
+		if (result.out_of_memory)
+			fprintf(stdout, "Failed: memory cap of %zu MB exceeded\n", limits.max_experiment_bytes >> 20);
+		else if (!result.ok)
+			fprintf(stdout, "Failed\n");
+		failed_num += !result.ok;
+		fprintf(stdout, "Peak memory: %.1f MB (+%.1f MB)\n\n",
+			result.peak_bytes / 1048576.0, result.GetPeakGrowth() / 1048576.0);
+	}
+	fprintf(stdout, "%u experiments, %u failed, %u ISL contexts\n",
+		experiment_num, failed_num, contexts.GetContextNum());
+	return failed_num > 0;
 }
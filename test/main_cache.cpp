@@ -0,0 +1,45 @@
+#include "cache.h"
+
+using namespace std;
+using namespace TENET;
+
+/*
+	Simulate the L1 and L2 of a dataflow on its access stream:
+	bin/cache <pe_array> <mapping> <statement> [lru|fifo|scratchpad] [slice dims]
+ */
+int main(int argc, char * argv[])
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "usage: %s <pe_array> <mapping> <statement> [lru|fifo|scratchpad] [slice dims]\n",
+			argv[0]);
+		return 1;
+	}
+	string policy_str = argc > 4 ? argv[4] : "lru";
+	CachePolicy policy = CachePolicy::LRU;
+	if (policy_str == "fifo")
+		policy = CachePolicy::FIFO;
+	else if (policy_str == "scratchpad")
+		policy = CachePolicy::SCRATCHPAD;
+	unsigned slice_dims = argc > 5 ? stoi(argv[5]) : 1;
+
+	shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+	PEArray pe(context);
+	Mapping mp(context);
+	Statement st(context);
+	if (!pe.Load(argv[1]) || !mp.Load(argv[2]) || !st.Load(argv[3]))
+	{
+		fprintf(stderr, "Load input failed\n");
+		return 1;
+	}
+	Dataflow df(move(st), move(pe), move(mp));
+	CacheReport report = CacheSimulator(df, policy).Run("", slice_dims);
+	fprintf(stdout, "L1: accesses %.0f hits %.0f neighbor hits %.0f hit rate %.3f\n",
+		report.l1.accesses, report.l1.hits, report.l1.neighbor_hits, report.l1.GetHitRate());
+	fprintf(stdout, "L2: accesses %.0f hits %.0f hit rate %.3f\n",
+		report.l2.accesses, report.l2.hits, report.l2.GetHitRate());
+	fprintf(stdout, "L2 traffic: %.0f Analytic unique volume: %.0f\n",
+		report.l2_traffic, report.analytic_unique);
+	fprintf(stdout, "DRAM traffic: %.0f\n", report.dram_traffic);
+	return 0;
+}
@@ -0,0 +1,46 @@
+#include "codegen.h"
+
+using namespace std;
+using namespace TENET;
+
+/*
+	Generate a functional simulator of a dataflow and print the analytic
+	volumes it should reproduce:
+	bin/codegen <pe_array> <mapping> <statement> <simulator.cpp>
+	g++ -O2 -std=c++17 simulator.cpp -o simulator && ./simulator
+ */
+int main(int argc, char * argv[])
+{
+	if (argc < 5)
+	{
+		fprintf(stderr, "usage: %s <pe_array> <mapping> <statement> <simulator.cpp>\n", argv[0]);
+		return 1;
+	}
+	shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+	PEArray pe(context);
+	Mapping mp(context);
+	Statement st(context);
+	if (!pe.Load(argv[1]) || !mp.Load(argv[2]) || !st.Load(argv[3]))
+	{
+		fprintf(stderr, "Load input failed\n");
+		return 1;
+	}
+	Dataflow df(move(st), move(pe), move(mp));
+	if (!WriteSimulator(df, argv[4]))
+	{
+		fprintf(stderr, "Write %s failed\n", argv[4]);
+		return 1;
+	}
+
+	auto [input, output] = df.GetTensorList();
+	fprintf(stdout, "Instances: %.0f\n", df.GetDomainSize());
+	for (auto [tensors, type] : {make_pair(input, AccessType::READ), make_pair(output, AccessType::WRITE)})
+		for (auto& tensor : tensors)
+		{
+			double total = df.GetTotalVolume(tensor, type);
+			double unique = df.GetUniqueVolume(tensor, type, df.MapSpaceTimeToNeighbor());
+			fprintf(stdout, "%s %s: total %.0f unique %.0f reused %.0f\n", tensor.c_str(),
+				type == AccessType::READ ? "READ" : "WRITE", total, unique, total - unique);
+		}
+	return 0;
+}
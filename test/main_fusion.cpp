@@ -0,0 +1,53 @@
+#include "fusion.h"
+
+using namespace std;
+using namespace TENET;
+
+/*
+	Compare a producer/consumer layer pair with and without fusion:
+	bin/fusion <pe_array> <producer.s> <producer.m> <producer tensor>
+		<consumer.s> <consumer.m> <consumer tensor> [dram bandwidth]
+	e.g. a squeeze layer writing O followed by an expand layer reading it as I
+ */
+int main(int argc, char * argv[])
+{
+	if (argc < 8)
+	{
+		fprintf(stderr, "usage: %s <pe_array> <producer.s> <producer.m> <producer tensor> "
+			"<consumer.s> <consumer.m> <consumer tensor> [dram bandwidth]\n", argv[0]);
+		return 1;
+	}
+	unsigned dram_bandwidth = argc > 8 ? stoi(argv[8]) : 64;
+	shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+
+	PEArray pe(context);
+	Statement producer_st(context), consumer_st(context);
+	Mapping producer_mp(context), consumer_mp(context);
+	if (!pe.Load(argv[1]))
+	{
+		fprintf(stderr, "Load PE %s failed\n", argv[1]);
+		return 1;
+	}
+	if (!producer_st.Load(argv[2]) || !consumer_st.Load(argv[5]))
+	{
+		fprintf(stderr, "Load Statement failed\n");
+		return 1;
+	}
+	if (!producer_mp.Load(argv[3]) || !consumer_mp.Load(argv[6]))
+	{
+		fprintf(stderr, "Load Mapping failed\n");
+		return 1;
+	}
+	Dataflow producer(move(producer_st), pe.copy(), move(producer_mp));
+	Dataflow consumer(move(consumer_st), move(pe), move(consumer_mp));
+	FusedPair pair(producer, argv[4], consumer, argv[7]);
+
+	fprintf(stdout, "Intermediate volume: %.0f\n", pair.GetIntermediateVolume());
+	fprintf(stdout, " PE resident: %.0f\n L2 resident: %.0f\n DRAM saving: %.0f\n",
+		pair.GetPEResidentVolume(), pair.GetL2ResidentVolume(), pair.GetDRAMSaving());
+	fprintf(stdout, "Delay: Unfused: %.0f; Fused: %.0f\n",
+		pair.GetUnfusedDelay(dram_bandwidth), pair.GetFusedDelay(dram_bandwidth));
+	fprintf(stdout, "Energy: Unfused: %.0f; Fused: %.0f\n",
+		pair.GetUnfusedEnergy(), pair.GetFusedEnergy());
+	return 0;
+}
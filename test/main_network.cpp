@@ -0,0 +1,78 @@
+#include "network.h"
+
+using namespace std;
+using namespace TENET;
+
+/*
+	Analyze a whole network description (data/networks) in one run:
+	bin/network <network> <pe_array> <mapping> [pointwise=<mapping>]
+		[input=HxWxC] [threads=N] [<param>=<value> ...]
+	e.g.
+	bin/network data/networks/squeezeNet_v1_1 data/pe_array/pe_16_16.p \
+		data/mapping/conv2d_os_16x16.m input=224x224x3 num_classes=1000
+ */
+int main(int argc, char * argv[])
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "usage: %s <network> <pe_array> <mapping> [pointwise=<mapping>] "
+			"[input=HxWxC] [threads=N] [<param>=<value> ...]\n", argv[0]);
+		return 1;
+	}
+	unsigned height = 224, width = 224, channel = 3, threads = 0;
+	string pointwise;
+	map<string, int> params;
+	for (int i = 4; i < argc; i++)
+	{
+		string arg = argv[i];
+		size_t pos = arg.find('=');
+		if (pos == string::npos)
+			continue;
+		string key = arg.substr(0, pos), value = arg.substr(pos + 1);
+		if (key == "input")
+			sscanf(value.c_str(), "%ux%ux%u", &height, &width, &channel);
+		else if (key == "threads")
+			threads = stoi(value);
+		else if (key == "pointwise")
+			pointwise = value;
+		else
+			params[key] = stoi(value);
+	}
+
+	Network net;
+	if (!net.Load(argv[1], height, width, channel, params))
+	{
+		fprintf(stderr, "Load Network %s failed\n", argv[1]);
+		return 1;
+	}
+	vector<LayerResult> results;
+	if (!net.Analyze(argv[2], argv[3], results,
+		pointwise.empty() ? nullptr : pointwise.c_str(), threads))
+		return 1;
+
+	auto& layers = net.GetLayers();
+	LayerResult total;
+	unsigned analyzed = 0, shapes = 0;
+	for (unsigned i = 0; i < layers.size(); i++)
+	{
+		if (!results[i].analyzed)
+			continue;
+		const Layer& layer = layers[i];
+		fprintf(stdout, "%s k=%u c=%u ox=%u oy=%u rx=%u ry=%u stride=%u\n",
+			layer.name.c_str(), layer.k, layer.c, layer.ox, layer.oy,
+			layer.rx, layer.ry, layer.stride);
+		fprintf(stdout, " MAC: %.0f Delay: %.0f Energy: %.0f Offchip: %.0f\n",
+			results[i].mac, results[i].delay, results[i].energy, results[i].offchip);
+		total.mac += results[i].mac;
+		total.delay += results[i].delay;
+		total.energy += results[i].energy;
+		total.offchip += results[i].offchip;
+		shapes = max(shapes, results[i].shape_id + 1);
+		analyzed++;
+	}
+	fprintf(stdout, "Network: %u layers, %u analyzed, %u unique shapes\n",
+		(unsigned)layers.size(), analyzed, shapes);
+	fprintf(stdout, "Total MAC: %.0f\nTotal Delay: %.0f\nTotal Energy: %.0f\nTotal Offchip: %.0f\n",
+		total.mac, total.delay, total.energy, total.offchip);
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include "ranker.h"
+
+using namespace std;
+using namespace TENET;
+
+/*
+	Rank the mappings of a statement on a PE array:
+	bin/rank <pe_array> <statement.s> <mapping.m>... [top=K] [samples=N]
+		[metric=delay|energy] [threads=N] [seed=N]
+	e.g.
+	bin/rank data/pe_array/pe_16_16.p data/statement/conv3_1_vgg16.s data/mapping/conv2d_*_16x16.m top=3
+ */
+int main(int argc, char * argv[])
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "usage: %s <pe_array> <statement.s> <mapping.m>... [top=K] [samples=N] "
+			"[metric=delay|energy] [threads=N] [seed=N]\n", argv[0]);
+		return 1;
+	}
+	unsigned top_k = 5, samples = 32, threads = 0, seed = 1;
+	RankMetric metric = RankMetric::DELAY;
+	vector<const char*> mapping_files;
+	for (int i = 3; i < argc; i++)
+	{
+		string arg = argv[i];
+		size_t pos = arg.find('=');
+		if (pos == string::npos)
+		{
+			mapping_files.push_back(argv[i]);
+			continue;
+		}
+		string key = arg.substr(0, pos), value = arg.substr(pos + 1);
+		if (key == "top")
+			top_k = stoi(value);
+		else if (key == "samples")
+			samples = stoi(value);
+		else if (key == "metric")
+			metric = value == "energy" ? RankMetric::ENERGY : RankMetric::DELAY;
+		else if (key == "threads")
+			threads = stoi(value);
+		else if (key == "seed")
+			seed = stoi(value);
+		else
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+	}
+
+	Ranker ranker(samples, seed);
+	if (!ranker.Load(argv[1], argv[2]))
+	{
+		fprintf(stderr, "Load PE %s or Statement %s failed\n", argv[1], argv[2]);
+		return 1;
+	}
+	for (auto file : mapping_files)
+		if (!ranker.AddMapping(file))
+			fprintf(stderr, "Load Mapping %s failed, skipped\n", file);
+
+	Ranking ranking = ranker.Rank(metric, top_k, threads);
+	const char* name = metric == RankMetric::DELAY ? "Delay" : "Energy";
+	fprintf(stdout, "%u mappings, exact %s of the top %u\n",
+		(unsigned)ranking.mappings.size(), name, ranking.top_k);
+	for (unsigned i = 0; i < ranking.mappings.size(); i++)
+	{
+		auto& mapping = ranking.mappings[i];
+		fprintf(stdout, "%3u %s Estimate: %.0f +- %.0f", i + 1, mapping.name.c_str(),
+			mapping.estimate, mapping.error);
+		if (mapping.exact_valid)
+			fprintf(stdout, " %s: %.0f", name, mapping.exact);
+		fprintf(stdout, "\n");
+	}
+	fprintf(stdout, "Confidence: %.3f Agreement: %.3f\n", ranking.confidence, ranking.agreement);
+	return 0;
+}
@@ -0,0 +1,36 @@
+#include "server.h"
+
+using namespace std;
+using namespace TENET;
+
+/*
+	Answer JSON-line analysis requests from stdin, or from a Unix socket:
+	bin/server [socket=<path>] [threads=<N>]
+	e.g. echo '{"id": 1, "statement": "data/statement/conv1_1_vgg16.s",
+		"mapping": "data/mapping/conv2d_os_16x16.m", "pe": "data/pe_array/pe_16_16.p",
+		"metrics": ["delay"]}' | bin/server
+ */
+int main(int argc, char * argv[])
+{
+	string socket_path;
+	unsigned num_threads = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg.rfind("socket=", 0) == 0)
+			socket_path = arg.substr(7);
+		else if (arg.rfind("threads=", 0) == 0)
+			num_threads = stoi(arg.substr(8));
+		else
+		{
+			fprintf(stderr, "usage: %s [socket=<path>] [threads=<N>]\n", argv[0]);
+			return 1;
+		}
+	}
+	AnalysisServer server(num_threads);
+	if (socket_path.empty())
+		server.Serve(stdin, stdout);
+	else if (!server.ServeSocket(socket_path.c_str()))
+		return 1;
+	return 0;
+}
@@ -0,0 +1,117 @@
+#include "trace.h"
+#include <sys/stat.h>
+
+using namespace std;
+using namespace TENET;
+
+namespace
+{
+
+string coords(const char* name, const vector<long>& values)
+{
+	string ret = string(name) + "[";
+	for (unsigned i = 0; i < values.size(); i++)
+		ret += (i ? "," : "") + to_string(values[i]);
+	return ret + "]";
+}
+
+int write(int argc, char * argv[])
+{
+	shared_ptr<ISL_Context> context{make_shared<ISL_Context>(stdout)};
+	PEArray pe(context);
+	Mapping mp(context);
+	Statement st(context);
+	if (!pe.Load(argv[2]) || !mp.Load(argv[3]) || !st.Load(argv[4]))
+	{
+		fprintf(stderr, "Load input failed\n");
+		return 1;
+	}
+	Dataflow df(move(st), move(pe), move(mp));
+	unsigned slice_dims = argc > 6 ? stoi(argv[6]) : 1;
+	if (!WriteTrace(df, argv[5], slice_dims))
+	{
+		fprintf(stderr, "Write %s failed\n", argv[5]);
+		return 1;
+	}
+	return 0;
+}
+
+int summary(const char* filename)
+{
+	TraceReader reader;
+	if (!reader.Open(filename))
+		return 1;
+	auto& header = reader.GetHeader();
+	vector<unsigned long> accesses(header.tensors.size(), 0);
+	unsigned long max_active = 0, active = 0, active_sum = 0, stamp = 0, total = 0;
+	vector<long> pe;
+	AccessEvent event;
+	while (reader.Next(event))
+	{
+		if (reader.GetTimeStampNum() != stamp)
+		{
+			max_active = max(max_active, active);
+			active_sum += active;
+			active = 0;
+			stamp = reader.GetTimeStampNum();
+			pe.clear();
+		}
+		if (event.pe != pe)
+		{
+			active++;
+			pe = event.pe;
+		}
+		accesses[event.tensor_id]++;
+		total++;
+	}
+	max_active = max(max_active, active);
+	active_sum += active;
+	struct stat info;
+	stat(filename, &info);
+	fprintf(stdout, "Time stamps: %lu\n", stamp);
+	fprintf(stdout, "Active PEs: max %lu average %.2f\n", max_active,
+		stamp ? (double)active_sum / stamp : 0.0);
+	for (unsigned i = 0; i < header.tensors.size(); i++)
+		fprintf(stdout, "%s %s: %lu accesses\n", header.tensors[i].name.c_str(),
+			header.tensors[i].type == AccessType::READ ? "READ" : "WRITE", accesses[i]);
+	fprintf(stdout, "Bytes per access: %.2f\n", total ? (double)info.st_size / total : 0.0);
+	return 0;
+}
+
+// print the accesses of the time stamps first..last, counted from 0
+int slice(const char* filename, unsigned long first, unsigned long last)
+{
+	TraceReader reader;
+	if (!reader.Open(filename))
+		return 1;
+	AccessEvent event;
+	while (reader.Next(event) && reader.GetTimeStampNum() <= last + 1)
+		if (reader.GetTimeStampNum() > first)
+			fprintf(stdout, "%s %s %s %s\n", coords("T", event.time).c_str(),
+				coords("PE", event.pe).c_str(), event.type == AccessType::READ ? "READ" : "WRITE",
+				coords(event.tensor->c_str(), event.element).c_str());
+	return 0;
+}
+
+} // namespace
+
+/*
+	Write, summarize or slice the binary access trace of a dataflow:
+	bin/trace write <pe_array> <mapping> <statement> <trace> [slice dims]
+	bin/trace summary <trace>
+	bin/trace slice <trace> <first time stamp> <last time stamp>
+ */
+int main(int argc, char * argv[])
+{
+	string command = argc > 1 ? argv[1] : "";
+	if (command == "write" && argc >= 6)
+		return write(argc, argv);
+	if (command == "summary" && argc >= 3)
+		return summary(argv[2]);
+	if (command == "slice" && argc >= 5)
+		return slice(argv[2], stoul(argv[3]), stoul(argv[4]));
+	fprintf(stderr, "usage: %s write <pe_array> <mapping> <statement> <trace> [slice dims]\n"
+		"       %s summary <trace>\n"
+		"       %s slice <trace> <first time stamp> <last time stamp>\n", argv[0], argv[0], argv[0]);
+	return 1;
+}
@@ -0,0 +1,107 @@
+#include "tuner.h"
+
+using namespace std;
+using namespace TENET;
+
+namespace
+{
+
+vector<unsigned> parse_list(const string& str)
+{
+	vector<unsigned> ret;
+	istringstream input(str);
+	string value;
+	while (getline(input, value, ','))
+		ret.push_back(stoi(value));
+	return ret;
+}
+
+} // namespace
+
+/*
+	Search PE array shapes and buffer sizes for a statement or a network:
+	bin/tuner <pe_template> <mapping_template> <statement.s | network>
+		[pe=N] [sram=N] [dims=a,b,..] [l1=a,b,..] [l2=a,b,..] [bw=a,b,..]
+		[dram_bw=N] [threads=N] [input=HxWxC] [<param>=<value> ...]
+	e.g.
+	bin/tuner data/pe_array/pe_template.p data/mapping/conv2d_os_template.m \
+		data/statement/conv1_1_vgg16.s pe=256 l1=64,256 l2=1024,65536 bw=32,64
+ */
+int main(int argc, char * argv[])
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "usage: %s <pe_template> <mapping_template> <statement.s | network> "
+			"[pe=N] [sram=N] [dims=a,b,..] [l1=a,b,..] [l2=a,b,..] [bw=a,b,..] "
+			"[dram_bw=N] [threads=N] [input=HxWxC] [<param>=<value> ...]\n", argv[0]);
+		return 1;
+	}
+	HardwareBudget budget;
+	TunerSpace space;
+	unsigned height = 224, width = 224, channel = 3, threads = 0;
+	map<string, int> params;
+	for (int i = 4; i < argc; i++)
+	{
+		string arg = argv[i];
+		size_t pos = arg.find('=');
+		if (pos == string::npos)
+			continue;
+		string key = arg.substr(0, pos), value = arg.substr(pos + 1);
+		if (key == "pe")
+			budget.max_pe = stoi(value);
+		else if (key == "sram")
+			budget.max_sram = stoi(value);
+		else if (key == "dims")
+			space.dims = parse_list(value);
+		else if (key == "l1")
+			space.l1_sizes = parse_list(value);
+		else if (key == "l2")
+			space.l2_sizes = parse_list(value);
+		else if (key == "bw")
+			space.bandwidths = parse_list(value);
+		else if (key == "dram_bw")
+			space.dram_bandwidth = stoi(value);
+		else if (key == "threads")
+			threads = stoi(value);
+		else if (key == "input")
+			sscanf(value.c_str(), "%ux%ux%u", &height, &width, &channel);
+		else
+			params[key] = stoi(value);
+	}
+
+	Tuner tuner;
+	if (!tuner.Load(argv[1], argv[2]))
+	{
+		fprintf(stderr, "Load templates %s %s failed\n", argv[1], argv[2]);
+		return 1;
+	}
+	string workload = argv[3];
+	Network net;
+	if (workload.size() > 2 && workload.substr(workload.size() - 2) == ".s")
+	{
+		if (!tuner.AddStatement(argv[3]))
+		{
+			fprintf(stderr, "Load Statement %s failed\n", argv[3]);
+			return 1;
+		}
+	}
+	else
+	{
+		if (!net.Load(argv[3], height, width, channel, params))
+		{
+			fprintf(stderr, "Load Network %s failed\n", argv[3]);
+			return 1;
+		}
+		tuner.AddNetwork(net);
+	}
+
+	auto configs = tuner.Search(budget, space, threads);
+	auto frontier = Tuner::GetFrontier(configs);
+	fprintf(stdout, "%u configurations, %u on the frontier\n",
+		(unsigned)configs.size(), (unsigned)frontier.size());
+	for (auto& config : frontier)
+		fprintf(stdout, "PE %ux%u L1: %u L2: %u Bandwidth: %u Delay: %.0f Energy: %.0f Area: %.1f\n",
+			config.x, config.y, config.l1size, config.l2size, config.bandwidth,
+			config.delay, config.energy, config.area);
+	return 0;
+}
@@ -1,4 +1,6 @@
-#include"dataflow.h"
+#include"cache.h"
+#include"context_manager.h"
+#include"server.h"
 
 using namespace TENET;
 using namespace std;
@@ -70,6 +72,35 @@ int test_statement(shared_ptr<ISL_Context> context)
 	return 0;
 }
 
+int test_canonical_key(shared_ptr<ISL_Context> context)
+{
+	Statement s1(context, "{S[i,j,k]:0<=i,j,k<8}");
+	s1.AddAccess(Access{context, "A", "{S[i,j,k]->A[i,k]}", false});
+	s1.AddAccess(Access{context, "B", "{S[i,j,k]->B[k,j]}", false});
+	s1.AddAccess(Access{context, "C", "{S[i,j,k]->C[i,j]}", true});
+	// same shape with renamed statement, iterators and tensors
+	Statement s2(context, "{Gemm[x,y,z]:z>=0 and z<=7 and 0<=x<8 and 0<=y<8}");
+	s2.AddAccess(Access{context, "Y", "{Gemm[x,y,z]->Y[z,y]}", false});
+	s2.AddAccess(Access{context, "X", "{Gemm[x,y,z]->X[x,z]}", false});
+	s2.AddAccess(Access{context, "Z", "{Gemm[x,y,z]->Z[x,y]}", true});
+	Statement s3(context, "{S[i,j,k]:0<=i,j,k<16}");
+	s3.AddAccess(Access{context, "A", "{S[i,j,k]->A[i,k]}", false});
+	s3.AddAccess(Access{context, "B", "{S[i,j,k]->B[k,j]}", false});
+	s3.AddAccess(Access{context, "C", "{S[i,j,k]->C[i,j]}", true});
+	fprintf(stdout, "Key:\n%s\n", s1.GetCanonicalKey().c_str());
+	fprintf(stdout, "Renamed equal: %d Suggested: 1\n", s1.GetCanonicalKey() == s2.GetCanonicalKey());
+	fprintf(stdout, "Resized equal: %d Suggested: 0\n", s1.GetCanonicalKey() == s3.GetCanonicalKey());
+	// same shape with an int8 A
+	Statement s4(context, "{S[i,j,k]:0<=i,j,k<8}");
+	Access a4{context, "A", "{S[i,j,k]->A[i,k]}", false};
+	a4.SetBits(8);
+	s4.AddAccess(move(a4));
+	s4.AddAccess(Access{context, "B", "{S[i,j,k]->B[k,j]}", false});
+	s4.AddAccess(Access{context, "C", "{S[i,j,k]->C[i,j]}", true});
+	fprintf(stdout, "Int8 A equal: %d Suggested: 0\n", s1.GetCanonicalKey() == s4.GetCanonicalKey());
+	return 0;
+}
+
 int test_dataflow(shared_ptr<ISL_Context> context)
 {
 	const char *pe_domain_str = "{PE[i]:0<=i<6}";
@@ -179,6 +210,445 @@ int test_dataflow_analysis(shared_ptr<ISL_Context> context)
 	return 0;
 }
 
+int test_pipeline_delay(shared_ptr<ISL_Context> context)
+{
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i+1]}", 256, 1024, 16, 1);
+	Statement s(context, "{S[t,i,k]:0<=t<8 and 0<=i<4 and 0<=k<4}");
+	s.AddAccess(Access{context, "A", "{S[t,i,k]->A[t,i,k]}", false});
+	s.AddAccess(Access{context, "B", "{S[t,i,k]->B[t,k]}", false});
+	s.AddAccess(Access{context, "C", "{S[t,i,k]->C[t,i]}", true});
+	Mapping m(context, "{S[t,i,k]->PE[i]}", "{S[t,i,k]->T[t,k]}");
+	Dataflow df(move(s), move(pe), move(m));
+	PipelineDelay delay = df.GetPipelineDelay(df.MapSpaceTimeToNeighbor(), 1);
+	fprintf(stdout, "Tiles: %u Total: %.0f Compute: %.0f Ingress stall: %.0f Egress stall: %.0f\n",
+		delay.tile_num, delay.total, delay.compute, delay.ingress_stall, delay.egress_stall);
+	fprintf(stdout, "Suggested: Tiles 8, Compute 32, Total = Compute + stalls\n");
+	return 0;
+}
+
+int test_bandwidth_profile(shared_ptr<ISL_Context> context)
+{
+	// skewed: PE i starts at time i, A is never reused, B[j] moves from PE 0 to the right
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[i,j]:0<=i<4 and 0<=j<8}");
+	s.AddAccess(Access{context, "A", "{S[i,j]->A[i,j]}", false});
+	s.AddAccess(Access{context, "B", "{S[i,j]->B[j]}", false});
+	s.AddAccess(Access{context, "C", "{S[i,j]->C[i]}", true});
+	Mapping m(context, "{S[i,j]->PE[i]}", "{S[i,j]->T[i+j]}");
+	Dataflow df(move(s), move(pe), move(m));
+	fprintf(stdout, "Profile:");
+	for (auto& sample : df.GetBandwidthProfile(df.MapSpaceTimeToNeighbor(), 1, AccessType::READ))
+		fprintf(stdout, " %.0f", sample.GetBandwidth());
+	fprintf(stdout, "\nSuggested: 32 48 64 80 80 80 80 80 48 32 16\n");
+	fprintf(stdout, "Peak: %.0f P50: %.0f P90: %.0f Suggested: 80 64 80\n",
+		df.GetPeakBandwidth(df.MapSpaceTimeToNeighbor(), 1, AccessType::READ),
+		df.GetPercentileBandwidth(df.MapSpaceTimeToNeighbor(), 1, AccessType::READ, 50),
+		df.GetPercentileBandwidth(df.MapSpaceTimeToNeighbor(), 1, AccessType::READ, 90));
+	return 0;
+}
+
+int test_working_set(shared_ptr<ISL_Context> context)
+{
+	// every PE keeps a row of B for the whole run
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i+1]}", 4, 64, 16, 1);
+	Statement s(context, "{S[i,j,k]:0<=i<4 and 0<=j<8 and 0<=k<8}");
+	s.AddAccess(Access{context, "B", "{S[i,j,k]->B[i,k]}", false});
+	s.AddAccess(Access{context, "C", "{S[i,j,k]->C[i,j]}", true});
+	Mapping m(context, "{S[i,j,k]->PE[i]}", "{S[i,j,k]->T[j,k]}");
+	Dataflow df(move(s), move(pe), move(m));
+	fprintf(stdout, "L1 working set B: %.0f Suggested: 8\n", df.GetL1WorkingSet("B", AccessType::READ));
+	fprintf(stdout, "L2 working set B: %.0f Suggested: 32\n", df.GetL2WorkingSet("B", AccessType::READ));
+	return 0;
+}
+
+int test_capacity_aware(shared_ptr<ISL_Context> context)
+{
+	// B is reused 7 time stamps later from the same PE, the L1 working set
+	// (7 B and 1 C) and the L2 working set (28 B and 4 C) fit to half
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i+1]}", 4, 16, 16, 1);
+	Statement s(context, "{S[i,j,k]:0<=i<4 and 0<=j<8 and 0<=k<7}");
+	s.AddAccess(Access{context, "B", "{S[i,j,k]->B[i,k]}", false});
+	s.AddAccess(Access{context, "C", "{S[i,j,k]->C[i,j]}", true});
+	Mapping m(context, "{S[i,j,k]->PE[i]}", "{S[i,j,k]->T[j,k]}");
+	Dataflow df(move(s), move(pe), move(m));
+	fprintf(stdout, "Unique B: %.0f Capacity aware: %.0f Suggested: 28 126\n",
+		df.GetUniqueVolume("B", AccessType::READ, df.MapSpaceTimeToNeighbor(1, true, 7)),
+		df.GetCapacityAwareUniqueVolume("B", AccessType::READ, df.MapSpaceTimeToNeighbor(1, true, 7)));
+	fprintf(stdout, "Footprint B: %.0f Capacity aware: %.0f Suggested: 28 77\n",
+		df.GetFootprint("B", AccessType::READ),
+		df.GetCapacityAwareFootprint("B", AccessType::READ, df.MapSpaceTimeToNeighbor(1, true, 7)));
+	return 0;
+}
+
+int test_dram_traffic(shared_ptr<ISL_Context> context)
+{
+	// W is reused by every tile of t and stays in L2
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i+1]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[t,i,k]:0<=t<8 and 0<=i<4 and 0<=k<4}");
+	s.AddAccess(Access{context, "A", "{S[t,i,k]->A[t,i,k]}", false});
+	s.AddAccess(Access{context, "W", "{S[t,i,k]->W[k]}", false});
+	s.AddAccess(Access{context, "C", "{S[t,i,k]->C[t,i]}", true});
+	Mapping m(context, "{S[t,i,k]->PE[i]}", "{S[t,i,k]->T[t,k]}");
+	Dataflow df(move(s), move(pe), move(m));
+	fprintf(stdout, "DRAM read A: %.0f W: %.0f Suggested: 128 4\n",
+		df.GetDRAMRead("A", 1), df.GetDRAMRead("W", 1));
+	fprintf(stdout, "DRAM write C: %.0f Suggested: 32\n", df.GetDRAMWrite("C", 1));
+	fprintf(stdout, "DRAM delay: %.0f Suggested: 656\n", df.GetDRAMDelay(1, 4));
+	return 0;
+}
+
+int test_pe_workload(shared_ptr<ISL_Context> context)
+{
+	// 10 columns folded onto 4 PEs, PE 0 and 1 get one more column
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i+1]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[i,j]:0<=i<10 and 0<=j<8}");
+	s.AddAccess(Access{context, "A", "{S[i,j]->A[i,j]}", false});
+	s.AddAccess(Access{context, "C", "{S[i,j]->C[i]}", true});
+	Mapping m(context, "{S[i,j]->PE[i%4]}", "{S[i,j]->T[floor(i/4),j]}");
+	Dataflow df(move(s), move(pe), move(m));
+	PEWorkload workload = df.GetPEWorkload();
+	fprintf(stdout, "MAC per PE: Max: %.0f Min: %.0f Average: %.0f Suggested: 24 16 20\n",
+		workload.max, workload.min, workload.average);
+	for (auto& [mac, pe_num] : workload.histogram)
+		fprintf(stdout, " %.0f MACs: %u PEs\n", mac, pe_num);
+	fprintf(stdout, "Computation delay: %.0f Suggested: 24\n", df.GetComputationDelay());
+	df.WritePEUtilization("pe_utilization.csv");
+	return 0;
+}
+
+int test_link_load(shared_ptr<ISL_Context> context)
+{
+	// B[j] enters PE 0 and moves one PE to the right every time stamp
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[i,j]:0<=i<4 and 0<=j<8}");
+	s.AddAccess(Access{context, "B", "{S[i,j]->B[j]}", false});
+	s.AddAccess(Access{context, "C", "{S[i,j]->C[i]}", true});
+	Mapping m(context, "{S[i,j]->PE[i]}", "{S[i,j]->T[i+j]}");
+	Dataflow df(move(s), move(pe), move(m));
+	for (auto& link : df.GetLinkLoad("B", AccessType::READ, df.MapSpaceTimeToNeighbor()))
+		fprintf(stdout, "PE[%ld]->PE[%ld] volume: %.0f peak: %.0f\n",
+			link.src[0], link.dst[0], link.volume, link.peak);
+	fprintf(stdout, "Suggested: 3 links, volume 8, peak 1\n");
+	fprintf(stdout, "Contention delay: %.0f Suggested: 11\n",
+		df.GetContentionDelay("B", AccessType::READ, df.MapSpaceTimeToNeighbor(), 16));
+	return 0;
+}
+
+int test_multicast(shared_ptr<ISL_Context> context)
+{
+	// every row of PEs reads the same A[t] in a cycle
+	PEArray pe(context, "{PE[i,j]:0<=i<4 and 0<=j<4}", "{PE[i,j]->PE[i-1,j]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[t,i,j]:0<=t<8 and 0<=i<4 and 0<=j<4}");
+	s.AddAccess(Access{context, "A", "{S[t,i,j]->A[t,i]}", false});
+	s.AddAccess(Access{context, "C", "{S[t,i,j]->C[t,i,j]}", true});
+	Mapping m(context, "{S[t,i,j]->PE[i,j]}", "{S[t,i,j]->T[t]}");
+	pe.SetMulticast("{PE[i,j]->Bus[i]}");
+	Dataflow df(move(s), move(pe), move(m));
+	fprintf(stdout, "Unique A: %.0f Suggested: 32\n",
+		df.GetUniqueVolume("A", AccessType::READ, df.MapSpaceTimeToNeighbor(0, false, 1, true, false)));
+	fprintf(stdout, "Fanout A: %.0f Suggested: 128\n",
+		df.GetMulticastFanout("A", df.MapSpaceTimeToNeighbor(0, false, 1, true, false)));
+	return 0;
+}
+
+int test_reduction(shared_ptr<ISL_Context> context)
+{
+	// the 4 PEs reduce over k every time stamp
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[t,i,k]:0<=t<8 and 0<=i<4 and 0<=k<4}");
+	s.AddAccess(Access{context, "A", "{S[t,i,k]->A[t,k]}", false});
+	s.AddAccess(Access{context, "C", "{S[t,i,k]->C[t,i]}", true});
+	Mapping m(context, "{S[t,i,k]->PE[k]}", "{S[t,i,k]->T[t,i]}");
+	Dataflow df(move(s), move(pe), move(m));
+	Reduction reduction = df.GetReduction("C");
+	fprintf(stdout, "Fanin: %.0f Depth: %u Adds: %.0f Egress: %.0f Suggested: 4 2 96 32\n",
+		reduction.max_fanin, reduction.depth, reduction.add_num, reduction.egress_volume);
+	return 0;
+}
+
+int test_reuse_histogram(shared_ptr<ISL_Context> context)
+{
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[i,j]:0<=i<4 and 0<=j<8}");
+	s.AddAccess(Access{context, "B", "{S[i,j]->B[j]}", false});
+	s.AddAccess(Access{context, "C", "{S[i,j]->C[i]}", true});
+	Mapping m(context, "{S[i,j]->PE[i]}", "{S[i,j]->T[i+j]}");
+	Dataflow df(move(s), move(pe), move(m));
+	auto temporal = df.GetTemporalReuseHistogram("C", AccessType::WRITE, 3);
+	fprintf(stdout, "Temporal C: %.0f %.0f %.0f Suggested: 28 0 0\n",
+		temporal[1], temporal[2], temporal[3]);
+	auto spatial = df.GetSpatialReuseHistogram("B", AccessType::READ, 2);
+	fprintf(stdout, "Spatial B: %.0f %.0f %.0f Suggested: 0 24 0\n",
+		spatial[0], spatial[1], spatial[2]);
+
+	// PE 1 is idle at time stamp 1 and reuses C[1] from 2 time stamps before
+	PEArray gap_pe(context, "{PE[i]:0<=i<2}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	Statement gap_s(context, "{S[i,j]:0<=i<2 and 0<=j<3 and (i=0 or j!=1)}");
+	gap_s.AddAccess(Access{context, "C", "{S[i,j]->C[i]}", true});
+	Mapping gap_m(context, "{S[i,j]->PE[i]}", "{S[i,j]->T[j]}");
+	Dataflow gap(move(gap_s), move(gap_pe), move(gap_m));
+	auto gap_temporal = gap.GetTemporalReuseHistogram("C", AccessType::WRITE, 3);
+	fprintf(stdout, "Temporal C with idle gap: %.0f %.0f %.0f Suggested: 2 1 0\n",
+		gap_temporal[1], gap_temporal[2], gap_temporal[3]);
+	return 0;
+}
+
+int test_bits_per_item(shared_ptr<ISL_Context> context)
+{
+	// int8 A compressed to half, int32 C
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[t,i]:0<=t<8 and 0<=i<4}");
+	Access a{context, "A", "{S[t,i]->A[t,i]}", false};
+	a.SetBits(8, 0.5);
+	Access c{context, "C", "{S[t,i]->C[t,i]}", true};
+	c.SetBits(32);
+	s.AddAccess(move(a));
+	s.AddAccess(move(c));
+	Mapping m(context, "{S[t,i]->PE[i]}", "{S[t,i]->T[t]}");
+	Dataflow df(move(s), move(pe), move(m));
+	fprintf(stdout, "Ingress delay: %.0f Suggested: 8\n",
+		df.GetIngressDelay(df.MapSpaceTimeToNeighbor()));
+	fprintf(stdout, "Egress delay: %.0f Suggested: 64\n",
+		df.GetEgressDelay(df.MapSpaceTimeToNeighbor()));
+	// malformed annotations fail the load instead of throwing
+	unsigned rejected = 0;
+	for (const char* option : {"bits=abc", "bits=99999999999", "bits=0", "compression=", "compression=-1"})
+	{
+		Statement bad(context);
+		istringstream input(string("1 0\n{S[i]:0<=i<4}\n{S[i]->A[i]} ") + option + "\n");
+		rejected += !bad.Load(input);
+	}
+	fprintf(stdout, "Rejected: %u Suggested: 5\n", rejected);
+	return 0;
+}
+
+int test_sparsity(shared_ptr<ISL_Context> context)
+{
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[i,j,k]:0<=i<4 and 0<=j<8 and 0<=k<8}");
+	Access a{context, "A", "{S[i,j,k]->A[i,k]}", false};
+	Sparsity sparsity;
+	sparsity.Parse("csf(0.5,0.25)");
+	a.SetSparsity(sparsity);
+	s.AddAccess(move(a));
+	s.AddAccess(Access{context, "B", "{S[i,j,k]->B[k,j]}", false});
+	s.AddAccess(Access{context, "C", "{S[i,j,k]->C[i,j]}", true});
+	Mapping m(context, "{S[i,j,k]->PE[i]}", "{S[i,j,k]->T[j,k]}");
+	Dataflow df(move(s), move(pe), move(m));
+	fprintf(stdout, "Expected MAC: %.0f Suggested: 32\n", df.GetExpectedMacNum());
+	fprintf(stdout, "Expected total A: %.0f Suggested: 32\n",
+		df.GetExpectedTotalVolume("A", AccessType::READ));
+	// dense B is only fetched for nonzero A, one fetch serves 4 PEs
+	fprintf(stdout, "Expected total B: %.0f unique B: %.2f reuse B: %.2f Suggested: 32 26.48 1.21\n",
+		df.GetExpectedTotalVolume("B", AccessType::READ),
+		df.GetExpectedUniqueVolume("B", AccessType::READ, df.MapSpaceTimeToNeighbor()),
+		df.GetExpectedReuseFactor("B", AccessType::READ, df.MapSpaceTimeToNeighbor()));
+
+	// 1x3 blocks of A, the last block of every row is padded
+	PEArray block_pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	Statement block_s(context, "{S[i,j,k]:0<=i<4 and 0<=j<8 and 0<=k<8}");
+	Access block_a{context, "A", "{S[i,j,k]->A[i,k]}", false};
+	Sparsity block;
+	block.Parse("block(0.5,1,3)");
+	block_a.SetSparsity(block);
+	block_s.AddAccess(move(block_a));
+	block_s.AddAccess(Access{context, "C", "{S[i,j,k]->C[i,j]}", true});
+	Mapping block_m(context, "{S[i,j,k]->PE[i]}", "{S[i,j,k]->T[j,k]}");
+	Dataflow block_df(move(block_s), move(block_pe), move(block_m));
+	fprintf(stdout, "Expected unique block A: %.0f Suggested: 144\n",
+		block_df.GetExpectedUniqueVolume("A", AccessType::READ, block_df.MapSpaceTimeToNeighbor()));
+	unsigned rejected = 0;
+	for (const char* model : {"csf(0.5,x)", "csf(0.5,)", "uniform(0)", "uniform(1.5)", "block(0.5,0)"})
+		rejected += !Sparsity().Parse(model);
+	fprintf(stdout, "Rejected: %u Suggested: 5\n", rejected);
+	return 0;
+}
+
+int test_pe_levels(shared_ptr<ISL_Context> context)
+{
+	// 2 clusters of 4 PEs, a chain in every cluster and a chain between clusters
+	PEArray pe(context, "{PE[c,p]:0<=c<2 and 0<=p<4}",
+		"{PE[c,p]->PE[c,p-1]; PE[c,p]->PE[c-1,p]}", 64, 1024, 16, 1);
+	pe.AddLevel("local", 16, 1, 64, "{PE[c,p]->C[c]}", "{PE[c,p]->PE[c,p-1]}");
+	pe.AddLevel("global", 32, 1, 1024, "{PE[c,p]->A[]}", "{PE[c,p]->PE[c-1,p]}");
+	Statement s(context, "{S[t,c,p]:0<=t<8 and 0<=c<2 and 0<=p<4}");
+	s.AddAccess(Access{context, "B", "{S[t,c,p]->B[t]}", false});
+	Mapping m(context, "{S[t,c,p]->PE[c,p]}", "{S[t,c,p]->T[t]}");
+	Dataflow df(move(s), move(pe), move(m));
+	auto traffic = df.GetLevelTraffic("B", AccessType::READ);
+	fprintf(stdout, "Local: reuse %.0f unique %.0f delay %.0f Suggested: 48 16 24\n",
+		traffic[0].reuse_volume, traffic[0].unique_volume, traffic[0].delay);
+	fprintf(stdout, "Global: reuse %.0f unique %.0f delay %.0f Suggested: 8 8 4\n",
+		traffic[1].reuse_volume, traffic[1].unique_volume, traffic[1].delay);
+
+	// a cluster uses 8 elements of B and only keeps 4 of them
+	PEArray small_pe(context, "{PE[c,p]:0<=c<2 and 0<=p<4}",
+		"{PE[c,p]->PE[c,p-1]; PE[c,p]->PE[c-1,p]}", 64, 1024, 16, 1);
+	small_pe.AddLevel("local", 16, 1, 4, "{PE[c,p]->C[c]}", "{PE[c,p]->PE[c,p-1]}");
+	small_pe.AddLevel("global", 32, 1, 1024, "{PE[c,p]->A[]}", "{PE[c,p]->PE[c-1,p]}");
+	Statement small_s(context, "{S[t,c,p]:0<=t<8 and 0<=c<2 and 0<=p<4}");
+	small_s.AddAccess(Access{context, "B", "{S[t,c,p]->B[t]}", false});
+	Mapping small_m(context, "{S[t,c,p]->PE[c,p]}", "{S[t,c,p]->T[t]}");
+	Dataflow small(move(small_s), move(small_pe), move(small_m));
+	auto small_traffic = small.GetLevelTraffic("B", AccessType::READ);
+	fprintf(stdout, "Small local: reuse %.0f unique %.0f delay %.0f Suggested: 24 40 12\n",
+		small_traffic[0].reuse_volume, small_traffic[0].unique_volume, small_traffic[0].delay);
+	fprintf(stdout, "Small global: reuse %.0f unique %.0f Suggested: 8 32\n",
+		small_traffic[1].reuse_volume, small_traffic[1].unique_volume);
+	return 0;
+}
+
+int test_device_split(shared_ptr<ISL_Context> context)
+{
+	// a 1D convolution split over 3 devices along x
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[k,x,r]:0<=k<4 and 0<=x<12 and 0<=r<3}");
+	s.AddAccess(Access{context, "W", "{S[k,x,r]->W[k,r]}", false});
+	s.AddAccess(Access{context, "I", "{S[k,x,r]->I[x+r]}", false});
+	s.AddAccess(Access{context, "O", "{S[k,x,r]->O[k,x]}", true});
+	Mapping m(context, "{S[k,x,r]->PE[x%4]}", "{S[k,x,r]->T[k,r]}");
+	m.SetDeviceMap("{S[k,x,r]->Dev[floor(x/4)]}");
+	Dataflow df(move(s), move(pe), move(m));
+	DeviceSplit split = df.GetDeviceSplit();
+	fprintf(stdout, "Devices: %u Balance: %.2f Suggested: 3 1.00\n", split.device_num, split.balance);
+	DeviceTraffic input = df.GetDeviceTraffic("I", AccessType::READ, 16);
+	fprintf(stdout, "I: halo %.0f replicated %.0f delay %.0f Suggested: 4 0 2\n",
+		input.halo_volume, input.replicated_volume, input.delay);
+	DeviceTraffic weight = df.GetDeviceTraffic("W", AccessType::READ, 16);
+	fprintf(stdout, "W: halo %.0f replicated %.0f Suggested: 0 24\n",
+		weight.halo_volume, weight.replicated_volume);
+	// the devices share PE and time stamps, each array only runs its own MACs
+	fprintf(stdout, "Max MAC per PE:");
+	for (auto& device : df.GetDeviceDataflows())
+		fprintf(stdout, " %.0f", device.GetPEWorkload().max);
+	fprintf(stdout, " Suggested: 12 12 12\n");
+	return 0;
+}
+
+int test_cache(shared_ptr<ISL_Context> context)
+{
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[i,j]:0<=i<4 and 0<=j<8}");
+	s.AddAccess(Access{context, "B", "{S[i,j]->B[j]}", false});
+	s.AddAccess(Access{context, "C", "{S[i,j]->C[i]}", true});
+	Mapping m(context, "{S[i,j]->PE[i]}", "{S[i,j]->T[i+j]}");
+	Dataflow df(move(s), move(pe), move(m));
+	CacheReport lru = CacheSimulator(df, CachePolicy::LRU).Run();
+	fprintf(stdout, "LRU: L2 traffic %.0f DRAM %.0f Analytic %.0f Suggested: 12 12 12\n",
+		lru.l2_traffic, lru.dram_traffic, lru.analytic_unique);
+	// B and C evict each other from a single item L1
+	CacheReport small = CacheSimulator(df, CachePolicy::LRU, true, 1).Run();
+	fprintf(stdout, "LRU L1=1: L2 traffic %.0f Suggested: 92\n", small.l2_traffic);
+	return 0;
+}
+
+int test_parallel_metrics(shared_ptr<ISL_Context> context)
+{
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	pe.SetMulticast("{PE[i]->Bus[0]}");
+	Statement s(context, "{S[k,x,r]:0<=k<4 and 0<=x<12 and 0<=r<3}");
+	Access w{context, "W", "{S[k,x,r]->W[k,r]}", false};
+	w.SetBits(8);
+	s.AddAccess(move(w));
+	s.AddAccess(Access{context, "I", "{S[k,x,r]->I[x+r]}", false});
+	s.AddAccess(Access{context, "O", "{S[k,x,r]->O[k,x]}", true});
+	Mapping m(context, "{S[k,x,r]->PE[x%4]}", "{S[k,x,r]->T[k,floor(x/4),r]}");
+	Dataflow df(move(s), move(pe), move(m));
+
+	// the copy rebuilt from text serializes to the same text
+	auto worker_context = make_shared<ISL_Context>(stdout);
+	auto copy = Dataflow::Deserialize(worker_context, df.Serialize());
+	DataflowText text = df.Serialize(), copy_text = copy->Serialize();
+	fprintf(stdout, "Round trip: %d Suggested: 1\n", text.statement == copy_text.statement &&
+		text.pe_array == copy_text.pe_array && text.mapping == copy_text.mapping);
+	copy.reset();
+
+	double delay = df.GetDelay(df.MapSpaceTimeToNeighbor());
+	double energy = df.GetEnergy(df.MapSpaceTimeToNeighbor());
+	double parallel_delay = df.GetParallelDelay(4), parallel_energy = df.GetParallelEnergy(4);
+	fprintf(stdout, "Delay: %.0f Parallel: %.0f Equal: %d Suggested: 1\n",
+		delay, parallel_delay, delay == parallel_delay);
+	fprintf(stdout, "Energy: %.2f Parallel: %.2f Equal: %d Suggested: 1\n",
+		energy, parallel_energy, fabs(energy - parallel_energy) <= 1e-9 * max(1.0, energy));
+	return 0;
+}
+
+int test_chunked_volume(shared_ptr<ISL_Context> context)
+{
+	PEArray pe(context, "{PE[i]:0<=i<4}", "{PE[i]->PE[i-1]}", 64, 1024, 16, 1);
+	Statement s(context, "{S[k,x,r]:0<=k<4 and 0<=x<12 and 0<=r<3}");
+	s.AddAccess(Access{context, "W", "{S[k,x,r]->W[k,r]}", false});
+	s.AddAccess(Access{context, "I", "{S[k,x,r]->I[x+r]}", false});
+	s.AddAccess(Access{context, "O", "{S[k,x,r]->O[k,x]}", true});
+	Mapping m(context, "{S[k,x,r]->PE[x%4]}", "{S[k,x,r]->T[floor(x/4),k,r]}");
+	Dataflow df(move(s), move(pe), move(m));
+	// reuse of I and O crosses the chunk boundaries of the outer time dim
+	for (auto [tensor, type] : {make_pair("I", AccessType::READ), make_pair("O", AccessType::WRITE)})
+	{
+		ChunkedVolume chunked = df.GetChunkedVolume(tensor, type, 3, 2);
+		fprintf(stdout, "%s: chunks %u total %.0f unique %.0f Suggested: 3 %.0f %.0f\n", tensor,
+			chunked.chunk_num, chunked.total, chunked.unique, df.GetTotalVolume(tensor, type),
+			df.GetUniqueVolume(tensor, type, df.MapSpaceTimeToNeighbor()));
+	}
+	return 0;
+}
+
+int test_context_manager()
+{
+	ContextLimits limits;
+	limits.max_experiments = 2;
+	ContextManager contexts(stdout, limits);
+	auto mac = [](shared_ptr<ISL_Context> context) {
+		Statement s(context, "{S[i,j]:0<=i<4 and 0<=j<8}");
+		return convert_upwqp_to_int(isl_union_set_card(s.GetDomain())) == 32;
+	};
+	unsigned ok = 0;
+	for (int i = 0; i < 3; i++)
+		ok += contexts.Run(mac).ok;
+	// a failed experiment gets a fresh context
+	ExperimentResult failed = contexts.Run([](shared_ptr<ISL_Context> context) {
+		return isl_union_set_read_from_str(context->ctx(), "{S[i]:") != NULL;
+	});
+	fprintf(stdout, "OK: %u Failed: %d Contexts: %u Suggested: 3 1 3\n",
+		ok, !failed.ok, contexts.GetContextNum());
+	// an allocation no watchdog sees is refused by the hard cap of the child
+	ContextLimits capped;
+	capped.max_experiment_bytes = size_t(64) << 20;
+	ExperimentResult runaway = ContextManager(stdout, capped).Run([](shared_ptr<ISL_Context>) {
+		vector<char> huge(size_t(16) << 30, 1);
+		return huge.back() == 1;
+	});
+	fprintf(stdout, "Out of memory: %d Suggested: 1\n", runaway.out_of_memory);
+	// a crash is a failure but not a memory cap hit
+	ExperimentResult crash = ContextManager(stdout, capped).Run([](shared_ptr<ISL_Context>) -> bool {
+		abort();
+	});
+	fprintf(stdout, "Crash: ok %d out of memory %d Suggested: 0 0\n", crash.ok, crash.out_of_memory);
+	return 0;
+}
+
+int test_server()
+{
+	AnalysisServer server(1);
+	FILE *in = tmpfile(), *out = tmpfile();
+	const char* request = "{\"id\": %d, \"statement\": \"1 1\\n{S[i]:0<=i<4}\\n{S[i]->A[i]}%s\\n{S[i]->O[i]}\", "
+		"\"mapping\": \"{S[i]->PE[i]}\\n{S[i]->T[0]}\", "
+		"\"pe\": \"{PE[i]:0<=i<4}\\n{PE[i]->PE[i+1]}\\n64 1024 16 1\", \"metrics\": [\"mac\"]}\n";
+	// a malformed annotation in inline text fails its request only
+	fprintf(in, request, 1, " bits=x");
+	fprintf(in, request, 2, "");
+	rewind(in);
+	server.Serve(in, out);
+	rewind(out);
+	char line[256];
+	while (fgets(line, sizeof(line), out))
+		fprintf(stdout, "%s", line);
+	fprintf(stdout, "Suggested: 1 with an error, 2 with mac 4\n");
+	fclose(in);
+	fclose(out);
+	return 0;
+}
+
 int test_dataload(shared_ptr<ISL_Context> context, const char* pe_file, const char* mapping_file, const char* statement_file)
 {
 	PEArray pe(context);